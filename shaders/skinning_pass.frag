@@ -0,0 +1,8 @@
+out vec4 output_color;
+
+//Nothing is rasterized during the skinning pass, but a program needs a
+//fragment shader
+void main()
+{
+  output_color = vec4(0.0f);
+}
@@ -0,0 +1,168 @@
+//#version 330
+
+//Morph and skin the vertices of a submesh once per frame. The results are
+//captured with transform feedback into the vertex buffers that every other pass
+//then draws. Built with NO_SKINNING for the meshes that are only morphed.
+
+//The results are stored as 32 bit floats, compute them at that precision
+precision highp float;
+
+layout (location = 0) in vec3 input_position;
+layout (location = 1) in vec3 input_normal;
+#ifndef NO_SKINNING
+layout (location = 4) in vec4 input_joints;
+layout (location = 5) in vec4 input_weights;
+#endif
+
+//Morph targets with a non zero weight, at most MAX_MORPH_TARGETS. The deltas of
+//target t for vertex v are the texels 2 * (t * morph_vertex_count + v) for the
+//position, and the next one for the normal. The weights include the scale of
+//the int16 deltas, that are read as integers.
+uniform int morph_target_count;
+uniform int morph_vertex_count;
+uniform int morph_targets[MAX_MORPH_TARGETS];
+uniform float morph_weights[MAX_MORPH_TARGETS];
+uniform float morph_normal_weights[MAX_MORPH_TARGETS];
+#ifdef INTEGER_MORPH_DELTAS
+uniform highp isampler2D morph_deltas;
+#else
+uniform highp sampler2D morph_deltas;
+#endif
+
+#ifndef NO_SKINNING
+//Joints of the skeleton, uploaded once per frame, for any number of joints.
+//A joint matrix is affine, its 3 first rows are 3 texels, read as the columns
+//of a mat3x4. A dual quaternion is 2 texels: the rotation, then the dual part.
+uniform highp sampler2D joint_palette;
+
+//When a vertex has more than 4 influences, all of them are read from textures
+//instead of input_joints and input_weights. The influences of vertex i are the
+//(joint, weight) texels [offset(i); offset(i + 1)) of `influences`.
+uniform bool sparse_influences;
+//highp, the offsets are exact integers that go past mediump precision
+uniform highp sampler2D influence_offsets;
+uniform highp sampler2D influences;
+#endif
+
+out vec3 skinned_position;
+out vec3 skinned_normal;
+
+ivec2 data_texel(highp sampler2D data, int index)
+{
+  int width = textureSize(data, 0).x;
+  return ivec2(index % width, index / width);
+}
+
+vec3 morph_delta(int index)
+{
+  int width = textureSize(morph_deltas, 0).x;
+  ivec2 texel = ivec2(index % width, index / width);
+  return vec3(texelFetch(morph_deltas, texel, 0).xyz);
+}
+
+void morph(inout vec3 position, inout vec3 normal)
+{
+  for(int i = 0; i < morph_target_count; ++i)
+  {
+    int texel = 2 * (morph_targets[i] * morph_vertex_count + gl_VertexID);
+    position += morph_weights[i] * morph_delta(texel);
+    normal += morph_normal_weights[i] * morph_delta(texel + 1);
+  }
+}
+
+#ifndef NO_SKINNING
+#ifdef DUAL_QUATERNION_SKINNING
+vec4 blended_real = vec4(0.0f);
+vec4 blended_dual = vec4(0.0f);
+
+void add_influence(int joint, float weight)
+{
+  int texel = 2 * joint;
+  vec4 real = texelFetch(joint_palette, data_texel(joint_palette, texel), 0);
+  vec4 dual = texelFetch(joint_palette, data_texel(joint_palette, texel + 1), 0);
+  //q and -q are the same rotation, blend them in the same hemisphere
+  if(dot(blended_real, real) < 0.0f) weight = -weight;
+  blended_real += weight * real;
+  blended_dual += weight * dual;
+}
+#else
+mat3x4 skin_matrix = mat3x4(0.0f);
+
+void add_influence(int joint, float weight)
+{
+  int texel = 3 * joint;
+  skin_matrix += weight * mat3x4(
+    texelFetch(joint_palette, data_texel(joint_palette, texel), 0),
+    texelFetch(joint_palette, data_texel(joint_palette, texel + 1), 0),
+    texelFetch(joint_palette, data_texel(joint_palette, texel + 2), 0));
+}
+#endif
+
+void blend_influences()
+{
+  if(!sparse_influences)
+  {
+    add_influence(int(input_joints.x), input_weights.x);
+    add_influence(int(input_joints.y), input_weights.y);
+    add_influence(int(input_joints.z), input_weights.z);
+    add_influence(int(input_joints.w), input_weights.w);
+    return;
+  }
+
+  int first = int(texelFetch(influence_offsets,
+    data_texel(influence_offsets, gl_VertexID), 0).r);
+  int last = int(texelFetch(influence_offsets,
+    data_texel(influence_offsets, gl_VertexID + 1), 0).r);
+  for(int i = first; i < last; ++i)
+  {
+    vec2 influence = texelFetch(influences, data_texel(influences, i), 0).rg;
+    add_influence(int(influence.x), influence.y);
+  }
+}
+#endif
+
+void main()
+{
+  vec3 position = input_position;
+  vec3 normal = input_normal;
+  morph(position, normal);
+
+#ifdef NO_SKINNING
+  skinned_position = position;
+  skinned_normal = normal;
+#else
+  blend_influences();
+
+#ifdef DUAL_QUATERNION_SKINNING
+  float norm = length(blended_real);
+  if(norm == 0.0f)
+  {
+    //No influence, zeros like the CPU skinning instead of NaNs
+    skinned_position = vec3(0.0f);
+    skinned_normal = vec3(0.0f);
+  }
+  else
+  {
+    vec4 real = blended_real / norm;
+    vec4 dual = blended_dual / norm;
+    //Rotate, then translate by 2 * dual * conjugate(real)
+    skinned_position = position
+      + 2.0f * cross(real.xyz, cross(real.xyz, position) + real.w * position)
+      + 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    //Morphed normals are not unit length
+    vec3 rotated_normal = normal
+      + 2.0f * cross(real.xyz, cross(real.xyz, normal) + real.w * normal);
+    float normal_length = length(rotated_normal);
+    skinned_normal = normal_length == 0.0f ? rotated_normal
+                                           : rotated_normal / normal_length;
+  }
+#else
+  //mat3(skin_matrix) is the transposed linear part, its inverse is the normal matrix
+  mat3 normal_skin_matrix = inverse(mat3(skin_matrix));
+  skinned_position = vec4(position, 1.0f) * skin_matrix;
+  skinned_normal = normalize(normal_skin_matrix * normal);
+#endif
+#endif
+
+  gl_Position = vec4(skinned_position, 1.0f);
+}
@@ -0,0 +1,111 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GLTF_INSIGHT_AFFINE_SSE
+#include <xmmintrin.h>
+#endif
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+/// Affine transform stored as the 3 first rows of a 4x4 matrix. The last row
+/// is always (0, 0, 0, 1), so it is neither stored nor computed. Each row holds
+/// a row of the linear part in xyz, and a component of the translation in w.
+struct affine {
+  glm::vec4 rows[3];
+};
+
+/// Compose translation * rotation * scale directly, without building and
+/// multiplying the 3 matrices. Same result as glm::toMat4() for the rotation.
+inline affine affine_from_trs(const glm::vec3& t, const glm::quat& r,
+                              const glm::vec3& s) {
+  const float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+  const float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+  const float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+
+  affine a;
+  a.rows[0] = glm::vec4((1.f - 2.f * (yy + zz)) * s.x, 2.f * (xy - wz) * s.y,
+                        2.f * (xz + wy) * s.z, t.x);
+  a.rows[1] = glm::vec4(2.f * (xy + wz) * s.x, (1.f - 2.f * (xx + zz)) * s.y,
+                        2.f * (yz - wx) * s.z, t.y);
+  a.rows[2] = glm::vec4(2.f * (xz - wy) * s.x, 2.f * (yz + wx) * s.y,
+                        (1.f - 2.f * (xx + yy)) * s.z, t.z);
+  return a;
+}
+
+/// Drop the last row of a matrix, that needs to be affine
+inline affine affine_from_mat4(const glm::mat4& m) {
+  affine a;
+  for (int row = 0; row < 3; ++row)
+    a.rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+  return a;
+}
+
+inline glm::mat4 affine_to_mat4(const affine& a) {
+  glm::mat4 m(1.f);
+  for (int row = 0; row < 3; ++row)
+    for (int column = 0; column < 4; ++column)
+      m[column][row] = a.rows[row][column];
+  return m;
+}
+
+/// Product of two affine transforms, `lhs` applied last
+inline affine operator*(const affine& lhs, const affine& rhs) {
+  affine result;
+#ifdef GLTF_INSIGHT_AFFINE_SSE
+  // Each row of the result is a linear combination of the rows of rhs, plus
+  // the translation that comes from the implicit (0, 0, 0, 1) row.
+  const __m128 rhs0 = _mm_loadu_ps(&rhs.rows[0].x);
+  const __m128 rhs1 = _mm_loadu_ps(&rhs.rows[1].x);
+  const __m128 rhs2 = _mm_loadu_ps(&rhs.rows[2].x);
+  const __m128 rhs3 = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+  for (int row = 0; row < 3; ++row) {
+    const glm::vec4& l = lhs.rows[row];
+    __m128 r = _mm_mul_ps(_mm_set1_ps(l.x), rhs0);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(l.y), rhs1));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(l.z), rhs2));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(l.w), rhs3));
+    _mm_storeu_ps(&result.rows[row].x, r);
+  }
+#else
+  for (int row = 0; row < 3; ++row) {
+    const glm::vec4& l = lhs.rows[row];
+    result.rows[row] = l.x * rhs.rows[0] + l.y * rhs.rows[1] +
+                       l.z * rhs.rows[2] + glm::vec4(0.f, 0.f, 0.f, l.w);
+  }
+#endif
+  return result;
+}
@@ -0,0 +1,501 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "animation-compression.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "gltf-graph.hh"
+
+namespace {
+
+/// Largest "smallest three" component magnitude
+const float smallest_three_range = 0.70710678118654752440f;
+
+/// Longest number of keys we accept to drop in a row, bounds fitting time
+const size_t max_fitted_span = 512;
+
+uint16_t quantize(float v, float min, float extent, float steps) {
+  if (extent <= 0.f) return 0;
+  const float normalized = glm::clamp((v - min) / extent, 0.f, 1.f);
+  return uint16_t(std::floor(normalized * steps + 0.5f));
+}
+
+float dequantize(uint16_t q, float min, float extent, float steps) {
+  return min + extent * float(q) / steps;
+}
+
+/// How far the tip of the bone moved, in scene units
+float error_between(animation::channel::path mode,
+                    const animation::channel::keyframe_content& a,
+                    const animation::channel::keyframe_content& b,
+                    float bone_length) {
+  switch (mode) {
+    case animation::channel::path::translation:
+      return glm::length(a.motion.translation - b.motion.translation);
+    case animation::channel::path::scale:
+      return glm::length(a.motion.scale - b.motion.scale) * bone_length;
+    case animation::channel::path::rotation: {
+      // chord of the arc described by the bone tip : 2L sin(angle / 2)
+      const float d = std::min(
+          std::fabs(glm::dot(a.motion.rotation, b.motion.rotation)), 1.f);
+      return 2.f * bone_length * std::sqrt(1.f - d * d);
+    }
+    case animation::channel::path::weight:
+    case animation::channel::path::not_assigned:
+      break;
+  }
+  return 0.f;
+}
+
+/// The length of a bone is taken as the distance to its farthest child
+float estimate_bone_length(const gltf_node* node, float default_length) {
+  float length = 0.f;
+  for (const auto& child : node->children)
+    length = std::max(length, glm::length(glm::vec3(child->local_xform[3])));
+  return length > 0.f ? length : default_length;
+}
+
+/// Time points used as the reference of the curve fitting. Cubic splines are
+/// densely resampled so that the fitted keys follow the curve in between the
+/// original ones.
+std::vector<float> reference_times(const animation::sampler& sampler) {
+  std::vector<float> times;
+  for (const auto& keyframe : sampler.keyframes)
+    times.push_back(keyframe.second);
+
+  if (sampler.mode == animation::sampler::interpolation::cubic_spline) {
+    const float start = times.front(), end = times.back();
+    const float step = 1.f / ANIMATION_FPS;
+    for (float t = start + step; t < end; t += step) times.push_back(t);
+    std::sort(times.begin(), times.end());
+  }
+
+  times.erase(std::unique(times.begin(), times.end()), times.end());
+  return times;
+}
+
+/// Number of floats stored in one keyframe_content for this path
+int component_count(animation::channel::path mode) {
+  switch (mode) {
+    case animation::channel::path::translation:
+    case animation::channel::path::scale:
+      return 3;
+    case animation::channel::path::rotation:
+      return 4;
+    case animation::channel::path::weight:
+      return 1;
+    case animation::channel::path::not_assigned:
+      break;
+  }
+  return 0;
+}
+
+const float* components(const animation::channel::keyframe_content& value) {
+  return reinterpret_cast<const float*>(&value.motion);
+}
+
+bool same_value(animation::channel::path mode,
+                const animation::channel::keyframe_content& a,
+                const animation::channel::keyframe_content& b) {
+  return std::equal(components(a), components(a) + component_count(mode),
+                    components(b));
+}
+
+/// Tolerance for a key to be reproduced "exactly" by interpolation. This only
+/// absorbs the rounding of the interpolation itself.
+const float interpolation_epsilon = 1e-6f;
+
+/// Check if `value` is what linear interpolation between `a` and `b` gives
+bool on_segment(animation::channel::path mode,
+                const animation::channel::keyframe_content& a,
+                const animation::channel::keyframe_content& b, float mix,
+                const animation::channel::keyframe_content& value) {
+  animation::channel::keyframe_content interpolated;
+  if (mode == animation::channel::path::rotation) {
+    interpolated.motion.rotation = glm::normalize(
+        glm::slerp(a.motion.rotation, b.motion.rotation, mix));
+    // q and -q are the same rotation
+    if (glm::dot(interpolated.motion.rotation, value.motion.rotation) < 0.f)
+      interpolated.motion.rotation = -interpolated.motion.rotation;
+  } else if (mode == animation::channel::path::weight) {
+    interpolated.motion.weight = glm::mix(a.motion.weight, b.motion.weight, mix);
+  } else {
+    interpolated.motion.translation =
+        glm::mix(a.motion.translation, b.motion.translation, mix);
+  }
+
+  for (int i = 0; i < component_count(mode); ++i) {
+    const float expected = components(value)[i];
+    if (std::fabs(components(interpolated)[i] - expected) >
+        interpolation_epsilon * std::max(1.f, std::fabs(expected)))
+      return false;
+  }
+  return true;
+}
+
+/// A channel is constant if all its keyframes hold the same value. For cubic
+/// splines the tangents also need to be null.
+bool is_constant(const animation::channel& chan,
+                 const animation::sampler& sampler, size_t per_key) {
+  const bool cubic =
+      sampler.mode == animation::sampler::interpolation::cubic_spline;
+  const size_t stride = cubic ? 3 * per_key : per_key;
+  const size_t value_offset = cubic ? per_key : 0;
+
+  animation::channel::keyframe_content zero;
+  for (size_t key = 0; key < sampler.keyframes.size(); ++key) {
+    for (size_t v = 0; v < per_key; ++v) {
+      const auto& first = chan.keyframes[value_offset + v].second;
+      if (!same_value(chan.mode, first,
+                      chan.keyframes[key * stride + value_offset + v].second))
+        return false;
+      if (cubic &&
+          (!same_value(chan.mode, zero,
+                       chan.keyframes[key * stride + v].second) ||
+           !same_value(chan.mode, zero,
+                       chan.keyframes[key * stride + 2 * per_key + v]
+                           .second)))
+        return false;
+    }
+  }
+  return true;
+}
+
+size_t values_per_key(const animation::channel& chan,
+                      const animation::sampler& sampler) {
+  const size_t per_key = chan.keyframes.size() / sampler.keyframes.size();
+  return sampler.mode == animation::sampler::interpolation::cubic_spline
+             ? per_key / 3
+             : per_key;
+}
+
+/// Find the keys of a LINEAR or STEP sampler that none of its channels need
+std::vector<size_t> needed_keys(
+    const animation::sampler& sampler,
+    const std::vector<animation::channel*>& users) {
+  const auto& keys = sampler.keyframes;
+  const bool step = sampler.mode == animation::sampler::interpolation::step;
+
+  // Check that all keys in ]first; last[ can be dropped
+  const auto span_is_redundant = [&](size_t first, size_t last) {
+    for (const auto* chan : users) {
+      const size_t per_key = values_per_key(*chan, sampler);
+      for (size_t key = first + 1; key < last; ++key) {
+        const float mix = (keys[key].second - keys[first].second) /
+                          (keys[last].second - keys[first].second);
+        for (size_t v = 0; v < per_key; ++v) {
+          const auto& a = chan->keyframes[first * per_key + v].second;
+          const auto& b = chan->keyframes[last * per_key + v].second;
+          const auto& value = chan->keyframes[key * per_key + v].second;
+          if (step ? !same_value(chan->mode, a, value)
+                   : !on_segment(chan->mode, a, b, mix, value))
+            return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  std::vector<size_t> kept(1, 0);
+  for (size_t last = 2; last < keys.size(); ++last) {
+    if (last - kept.back() > max_fitted_span ||
+        !span_is_redundant(kept.back(), last))
+      kept.push_back(last - 1);
+  }
+  kept.push_back(keys.size() - 1);
+  return kept;
+}
+
+}  // namespace
+
+void fold_animations(std::vector<animation>& animations) {
+  using channel = animation::channel;
+
+  // Count how many channels write to each node property
+  std::map<std::pair<const gltf_node*, channel::path>, int> writers;
+  for (const auto& anim : animations)
+    for (const auto& chan : anim.channels)
+      if (chan.target_graph_node)
+        writers[std::make_pair(chan.target_graph_node, chan.mode)]++;
+
+  for (auto& anim : animations) {
+    auto& report = anim.folding;
+
+    for (auto& chan : anim.channels) {
+      const auto& sampler = anim.samplers[size_t(chan.sampler_index)];
+      if (chan.is_static || !chan.compressed.empty() ||
+          !chan.target_graph_node || sampler.keyframes.empty() ||
+          writers[std::make_pair(chan.target_graph_node, chan.mode)] != 1)
+        continue;
+
+      const size_t per_key = values_per_key(chan, sampler);
+      if (per_key == 0 || !is_constant(chan, sampler, per_key)) continue;
+
+      // Only keep the values of the first keyframe
+      const size_t value_offset =
+          sampler.mode == animation::sampler::interpolation::cubic_spline
+              ? per_key
+              : 0;
+      std::vector<std::pair<int, channel::keyframe_content>> value(
+          chan.keyframes.begin() + long(value_offset),
+          chan.keyframes.begin() + long(value_offset + per_key));
+      for (size_t v = 0; v < value.size(); ++v) value[v].first = int(v);
+
+      report.removed_keys += chan.keyframes.size() - value.size();
+      report.static_channels++;
+      chan.keyframes = std::move(value);
+      chan.is_static = true;
+      chan.cubic_coefficients.clear();
+    }
+
+    for (size_t s = 0; s < anim.samplers.size(); ++s) {
+      auto& sampler = anim.samplers[s];
+      if (sampler.keyframes.size() < 3 ||
+          sampler.mode == animation::sampler::interpolation::cubic_spline ||
+          sampler.mode == animation::sampler::interpolation::not_assigned)
+        continue;
+
+      std::vector<channel*> users;
+      bool can_fold = true;
+      for (auto& chan : anim.channels) {
+        if (chan.sampler_index != int(s) || chan.is_static) continue;
+        can_fold = can_fold && chan.compressed.empty() &&
+                   !chan.keyframes.empty() &&
+                   chan.keyframes.size() % sampler.keyframes.size() == 0;
+        users.push_back(&chan);
+      }
+      if (!can_fold || users.empty()) continue;
+
+      const auto kept = needed_keys(sampler, users);
+      if (kept.size() == sampler.keyframes.size()) continue;
+
+      // Renumber the keys of the sampler and of the channels using it
+      for (auto* chan : users) {
+        const size_t per_key = values_per_key(*chan, sampler);
+        std::vector<std::pair<int, channel::keyframe_content>> keyframes;
+        keyframes.reserve(kept.size() * per_key);
+        for (const auto key : kept)
+          for (size_t v = 0; v < per_key; ++v)
+            keyframes.push_back(std::make_pair(
+                int(keyframes.size()), chan->keyframes[key * per_key + v].second));
+
+        report.removed_keys += chan->keyframes.size() - keyframes.size();
+        chan->keyframes = std::move(keyframes);
+      }
+
+      std::vector<std::pair<int, float>> sampler_keyframes;
+      sampler_keyframes.reserve(kept.size());
+      for (const auto key : kept)
+        sampler_keyframes.push_back(std::make_pair(
+            int(sampler_keyframes.size()), sampler.keyframes[key].second));
+      sampler.keyframes = std::move(sampler_keyframes);
+    }
+  }
+}
+
+void pack_quaternion_smallest_three(const glm::quat& q, uint16_t* packed) {
+  const float components[4] = {q.x, q.y, q.z, q.w};
+
+  int largest = 0;
+  for (int i = 1; i < 4; ++i)
+    if (std::fabs(components[i]) > std::fabs(components[largest])) largest = i;
+
+  // q and -q are the same rotation, make the dropped component positive
+  const float sign = components[largest] < 0.f ? -1.f : 1.f;
+
+  uint64_t bits = uint64_t(largest);
+  for (int i = 0; i < 4; ++i) {
+    if (i == largest) continue;
+    bits = (bits << 15) | quantize(sign * components[i], -smallest_three_range,
+                                   2.f * smallest_three_range, 32767.f);
+  }
+
+  // 2 + 3 * 15 = 47 bits, stored in 3 words
+  packed[0] = uint16_t(bits >> 32);
+  packed[1] = uint16_t(bits >> 16);
+  packed[2] = uint16_t(bits);
+}
+
+glm::quat unpack_quaternion_smallest_three(const uint16_t* packed) {
+  const uint64_t bits = (uint64_t(packed[0]) << 32) |
+                        (uint64_t(packed[1]) << 16) | uint64_t(packed[2]);
+  const int largest = int((bits >> 45) & 0x3);
+
+  float components[4];
+  float sum = 0.f;
+  int shift = 30;
+  for (int i = 0; i < 4; ++i) {
+    if (i == largest) continue;
+    components[i] =
+        dequantize(uint16_t((bits >> shift) & 0x7fff), -smallest_three_range,
+                   2.f * smallest_three_range, 32767.f);
+    sum += components[i] * components[i];
+    shift -= 15;
+  }
+  components[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+
+  return glm::normalize(
+      glm::quat(components[3], components[0], components[1], components[2]));
+}
+
+void pack_quantized_vector(const glm::vec3& v, const glm::vec3& min,
+                           const glm::vec3& extent, uint16_t* packed) {
+  for (int i = 0; i < 3; ++i)
+    packed[i] = quantize(v[i], min[i], extent[i], 65535.f);
+}
+
+glm::vec3 unpack_quantized_vector(const uint16_t* packed, const glm::vec3& min,
+                                  const glm::vec3& extent) {
+  return glm::vec3(dequantize(packed[0], min[0], extent[0], 65535.f),
+                   dequantize(packed[1], min[1], extent[1], 65535.f),
+                   dequantize(packed[2], min[2], extent[2], 65535.f));
+}
+
+void compress_animation(animation& anim,
+                        const animation_compression_settings& settings) {
+  using channel = animation::channel;
+
+  auto& report = anim.compression;
+
+  for (auto& chan : anim.channels) {
+    if (!chan.compressed.empty() || chan.is_static) continue;
+
+    const auto& sampler = anim.samplers[size_t(chan.sampler_index)];
+    if (chan.mode == channel::path::weight ||
+        chan.mode == channel::path::not_assigned || !chan.target_graph_node ||
+        sampler.keyframes.size() < 2) {
+      report.skipped_channels++;
+      continue;
+    }
+
+    const bool is_rotation = chan.mode == channel::path::rotation;
+    const bool is_step = sampler.mode == animation::sampler::interpolation::step;
+    const float bone_length = estimate_bone_length(
+        chan.target_graph_node, settings.default_bone_length);
+
+    // Sample the original curve
+    const auto times = reference_times(sampler);
+    std::vector<channel::keyframe_content> reference(times.size());
+    for (size_t i = 0; i < times.size(); ++i)
+      anim.sample_channel(chan, times[i], reference[i]);
+
+    channel::compressed_track track;
+    track.step = is_step;
+
+    if (!is_rotation) {
+      glm::vec3 min = reference[0].motion.translation;
+      glm::vec3 max = min;
+      for (const auto& value : reference) {
+        min = glm::min(min, value.motion.translation);
+        max = glm::max(max, value.motion.translation);
+      }
+      track.range_min = min;
+      track.range_extent = max - min;
+    }
+
+    // Quantize every reference sample, the fitting only picks among them
+    std::vector<uint16_t> quantized(3 * reference.size());
+    std::vector<channel::keyframe_content> decoded(reference.size());
+    for (size_t i = 0; i < reference.size(); ++i) {
+      uint16_t* key = &quantized[3 * i];
+      if (is_rotation) {
+        pack_quaternion_smallest_three(reference[i].motion.rotation, key);
+        decoded[i].motion.rotation = unpack_quaternion_smallest_three(key);
+      } else {
+        pack_quantized_vector(reference[i].motion.translation, track.range_min,
+                              track.range_extent, key);
+        decoded[i].motion.translation =
+            unpack_quantized_vector(key, track.range_min, track.range_extent);
+      }
+    }
+
+    // Value reconstructed at sample i when the surrounding keys are `first`
+    // and `last`
+    const auto reconstruct = [&](size_t first, size_t last, size_t i) {
+      if (is_step) return decoded[first];
+      const float mix = (times[i] - times[first]) / (times[last] - times[first]);
+      channel::keyframe_content value;
+      if (is_rotation)
+        value.motion.rotation = glm::normalize(glm::slerp(
+            decoded[first].motion.rotation, decoded[last].motion.rotation, mix));
+      else
+        value.motion.translation =
+            glm::mix(decoded[first].motion.translation,
+                     decoded[last].motion.translation, mix);
+      return value;
+    };
+
+    const auto span_fits = [&](size_t first, size_t last) {
+      for (size_t i = first + 1; i < last; ++i)
+        if (error_between(chan.mode, reference[i], reconstruct(first, last, i),
+                          bone_length) > settings.position_tolerance)
+          return false;
+      return true;
+    };
+
+    // Greedy fitting : extend each segment as long as the samples it skips
+    // stay within tolerance
+    std::vector<size_t> kept(1, 0);
+    size_t first = 0;
+    for (size_t last = 2; last < reference.size(); ++last) {
+      if (last - first > max_fitted_span || !span_fits(first, last)) {
+        first = last - 1;
+        kept.push_back(first);
+      }
+    }
+    if (kept.back() != reference.size() - 1) kept.push_back(reference.size() - 1);
+
+    for (const auto index : kept) {
+      track.times.push_back(times[index]);
+      track.data.insert(track.data.end(), quantized.begin() + long(3 * index),
+                        quantized.begin() + long(3 * index + 3));
+    }
+
+    report.raw_keys += chan.keyframes.size();
+    report.raw_bytes +=
+        chan.keyframes.size() * sizeof(chan.keyframes.front());
+    report.compressed_keys += track.times.size();
+    report.compressed_bytes += track.byte_size();
+    report.compressed_channels++;
+
+    chan.compressed = std::move(track);
+    std::vector<std::pair<int, channel::keyframe_content>>().swap(
+        chan.keyframes);
+    std::vector<glm::vec4>().swap(chan.cubic_coefficients);
+
+    // Measure what we actually get back against the original curve
+    for (size_t i = 0; i < times.size(); ++i) {
+      channel::keyframe_content value;
+      if (anim.sample_channel(chan, times[i], value))
+        report.max_error =
+            std::max(report.max_error, error_between(chan.mode, reference[i],
+                                                     value, bone_length));
+    }
+  }
+
+  report.compressed = report.compressed_channels > 0;
+}
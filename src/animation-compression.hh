@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#include "animation.hh"
+
+/// Tuning of the lossy animation compression
+struct animation_compression_settings {
+  /// Maximum displacement of a joint tip allowed by the compression, in scene
+  /// units
+  float position_tolerance = 0.001f;
+
+  /// Length used to turn a rotation or scale error into a displacement when
+  /// the animated node has no child to measure a bone from
+  float default_bone_length = 1.f;
+};
+
+/// Lossless load-time simplification of a set of animations :
+///  - channels that never change are marked static, their value is kept once
+///  - keys that are exactly reproduced by interpolating their neighbours are
+///    removed from the samplers (LINEAR and STEP only)
+///
+/// A channel is only made static when nothing else animates the same node
+/// property, as the value is written once instead of every frame. The result
+/// is stored in `animation::folding`. This needs the channels to point to
+/// their target node.
+void fold_animations(std::vector<animation>& animations);
+
+/// Quantize a unit quaternion into 48 bits : the index of the largest
+/// component on 2 bits, and the 3 other ones on 15 bits each.
+void pack_quaternion_smallest_three(const glm::quat& q, uint16_t* packed);
+
+/// Inverse of `pack_quaternion_smallest_three()`
+glm::quat unpack_quaternion_smallest_three(const uint16_t* packed);
+
+/// Quantize each component of `v` on 16 bits inside [min; min + extent]
+void pack_quantized_vector(const glm::vec3& v, const glm::vec3& min,
+                           const glm::vec3& extent, uint16_t* packed);
+
+/// Inverse of `pack_quantized_vector()`
+glm::vec3 unpack_quantized_vector(const uint16_t* packed, const glm::vec3& min,
+                                  const glm::vec3& extent);
+
+/// Refit and quantize the translation, rotation and scale channels of an
+/// animation. The keys that can be reconstructed by interpolation within the
+/// tolerance are dropped, and the original keyframe arrays are released.
+/// Morph target weight channels are left untouched. The result is stored in
+/// `anim.compression`.
+///
+/// The channels must already point to their target node (see
+/// `animation::set_gltf_graph_targets()`), as the bone lengths are used to
+/// estimate the error.
+void compress_animation(animation& anim,
+                        const animation_compression_settings& settings);
@@ -29,7 +29,12 @@ SOFTWARE.
 
 #include "animation.hh"
 
+#include <algorithm>
+#include <chrono>
+
+#include "animation-compression.hh"
 #include "gltf-graph.hh"
+#include "pose-cache.hh"
 
 void animation::set_playing_state(bool state) { playing = state; }
 
@@ -75,7 +80,14 @@ void animation::compute_time_boundaries() {
 }
 
 animation::animation()
-    : current_time(0), min_time(0), max_time(0), playing(false), name() {}
+    : current_time(0),
+      min_time(0),
+      max_time(0),
+      playing(false),
+      name(),
+      revision(0),
+      inert_channels(0),
+      static_pose_applied(false) {}
 
 /// Assign to each animation channel a pointer to the node they control
 
@@ -90,229 +102,430 @@ void animation::set_gltf_graph_targets(gltf_node* root_node) {
 }
 
 void animation::apply_pose() {
+  if (!static_pose_applied) {
+    for (const auto& channel : channels)
+      if (channel.is_static && channel.target_graph_node)
+        apply_static_channel(channel);
+    static_pose_applied = true;
+  }
+
+  if (baked_poses) {
+    inert_channels = baked_poses->apply(*this, current_time);
+    return;
+  }
+
+  inert_channels = 0;
   for (auto& channel : channels) {
-    const auto& sampler = samplers[size_t(channel.sampler_index)];
+    if (channel.is_static) continue;
+    if (!channel.target_graph_node || !channel_covers(channel, current_time)) {
+      inert_channels++;
+      continue;
+    }
 
     // TODO probably a special case when animation has only *one* keyframe :
     // see https://github.com/KhronosGroup/glTF/issues/1597
 
-    // Storage for the lower and upper keyframes
-    std::array<std::pair<int, float>, 2> keyframe_interval;
-    bool found = false;
+    if (channel.mode == channel::path::weight) {
+      auto& blend_weights = channel.target_graph_node->pose.blend_weights;
+      sample_weights(channel, current_time, blend_weights.data(),
+                     blend_weights.size());
+      continue;
+    }
 
-    // Search the 2 keyframes that we need to interpolate between
-    for (size_t frame = 0; frame < sampler.keyframes.size() - 1; frame++) {
-      keyframe_interval[0] = sampler.keyframes[frame];
-      keyframe_interval[1] = sampler.keyframes[frame + 1];
+    channel::keyframe_content value;
+    if (sample_channel(channel, current_time, value))
+      write_channel_target(channel, value);
+  }
+}
 
-      if (keyframe_interval[0].second <= current_time &&
-          keyframe_interval[1].second >= current_time) {
-        found = true;
-        break;
-      }
-    }
+bool animation::channel_covers(const channel& chan, float time) const {
+  if (!chan.compressed.empty())
+    return time >= chan.compressed.times.front() &&
+           time <= chan.compressed.times.back();
+
+  const auto& keyframes = samplers[size_t(chan.sampler_index)].keyframes;
+  return keyframes.size() >= 2 && time >= keyframes.front().second &&
+         time <= keyframes.back().second;
+}
+
+void animation::apply_static_channel(const channel& chan) {
+  if (chan.mode != channel::path::weight) {
+    write_channel_target(chan, chan.keyframes.front().second);
+    return;
+  }
+
+  auto& blend_weights = chan.target_graph_node->pose.blend_weights;
+  for (size_t w = 0; w < blend_weights.size() && w < chan.keyframes.size();
+       ++w)
+    blend_weights[w] = chan.keyframes[w].second.motion.weight;
+}
+
+bool animation::sample_channel(const channel& chan, float time,
+                               channel::keyframe_content& value) const {
+  if (!chan.compressed.empty()) return sample_compressed(chan, time, value);
+
+  const auto& sampler = samplers[size_t(chan.sampler_index)];
+  keyframe_interval interval;
+  if (!find_keyframe_interval(sampler, time, interval)) return false;
+
+  // knowing what to interpolate, the interpolation method to use, the 2
+  // keyframe index and the interpolation value, we can then calculate the
+  // channel target
+  value = interpolate(chan, sampler.mode, interval);
+  return true;
+}
+
+bool animation::find_keyframe_interval(const sampler& s, float time,
+                                       keyframe_interval& interval) {
+  if (s.keyframes.size() < 2) return false;
+
+  for (size_t frame = 0; frame < s.keyframes.size() - 1; frame++) {
+    const auto& lower = s.keyframes[frame];
+    const auto& upper = s.keyframes[frame + 1];
 
-    // If found, compute the interpolation value
-    if (found) {
-      const int lower_frame = keyframe_interval[0].first;
-      const int upper_frame = keyframe_interval[1].first;
-      const float lower_time = keyframe_interval[0].second;
-      const float upper_time = keyframe_interval[1].second;
+    if (lower.second <= time && upper.second >= time) {
+      interval.lower_frame = lower.first;
+      interval.upper_frame = upper.first;
+      interval.lower_time = lower.second;
+      interval.upper_time = upper.second;
 
       // current_time is a value between [lower_time; upper_time]
       // we want to change that to be between [0.f; 1.f]
-      const float interpolation_value =
-          (current_time - lower_time) / (upper_time - lower_time);
+      interval.interpolation_value =
+          (time - interval.lower_time) /
+          (interval.upper_time - interval.lower_time);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void animation::compute_cubic_coefficients() {
+  for (auto& chan : channels) {
+    chan.cubic_coefficients.clear();
+
+    const auto& sampler = samplers[size_t(chan.sampler_index)];
+    if (sampler.mode != sampler::interpolation::cubic_spline ||
+        chan.is_static || sampler.keyframes.size() < 2)
+      continue;
+
+    /*
+     * When the sampler is set to cubic spline interpolation, each keyframe
+     * in the channel is actually composed of 3 elements :
+     *
+     *  - An Input Tangent
+     *  - The value at the keyframe
+     *  - An output Tangent
+     *
+     *  The "channel" array is thus 3 times bigger than the number of
+     * keyframes defined in the sampler (times the number of weights for
+     * morph target animation).
+     *
+     *  The input and output tangent needs to be scaled by the keyframe
+     * duration (upper_time - lower_time), the define the level of "cubic
+     * smoothing" around the time point.
+     *
+     *  To interpolate between two keyframes we need the point corresponding
+     * to the lower and upper frame (p0 and p1) and we need the output tangent
+     * of the lower frame, and the input tangent of the upper frame. The
+     * scaled tangents are called m0 and m1 in the glTF specification
+     * (Appendix C).
+     *
+     *  Expanding the Hermite basis gives, for t in [0; 1] :
+     *    p(t) = a t^3 + b t^2 + c t + d
+     *  with a = 2 p0 + m0 - 2 p1 + m1, b = -3 p0 - 2 m0 + 3 p1 - m1,
+     *  c = m0 and d = p0. This is done once here for each segment.
+     */
+    const size_t nb_segments = sampler.keyframes.size() - 1;
+    const size_t nb_values = chan.keyframes.size() / (3 * (nb_segments + 1));
+    const auto as_vec4 = [&](size_t index) {
+      const auto& motion = chan.keyframes[index].second.motion;
+      switch (chan.mode) {
+        case channel::path::rotation:
+          return glm::vec4(motion.rotation.x, motion.rotation.y,
+                           motion.rotation.z, motion.rotation.w);
+        case channel::path::weight:
+          return glm::vec4(motion.weight, 0.f, 0.f, 0.f);
+        case channel::path::translation:
+        case channel::path::scale:
+        case channel::path::not_assigned:
+          break;
+      }
+      return glm::vec4(motion.translation, 0.f);
+    };
+
+    for (size_t segment = 0; segment < nb_segments; ++segment) {
+      const float frame_delta = sampler.keyframes[segment + 1].second -
+                                sampler.keyframes[segment].second;
+      for (size_t v = 0; v < nb_values; ++v) {
+        const size_t lower = 3 * segment * nb_values, upper = lower + 3 * nb_values;
+        const glm::vec4 p0 = as_vec4(lower + nb_values + v);
+        const glm::vec4 m0 = frame_delta * as_vec4(lower + 2 * nb_values + v);
+        const glm::vec4 m1 = frame_delta * as_vec4(upper + v);
+        const glm::vec4 p1 = as_vec4(upper + nb_values + v);
+
+        const glm::vec4 a = 2.f * p0 + m0 - 2.f * p1 + m1;
+        const glm::vec4 b = -3.f * p0 - 2.f * m0 + 3.f * p1 - m1;
+
+        // Weights are scalars, their 4 coefficients fit in one vec4
+        if (chan.mode == channel::path::weight) {
+          chan.cubic_coefficients.push_back(glm::vec4(a.x, b.x, m0.x, p0.x));
+        } else {
+          chan.cubic_coefficients.push_back(a);
+          chan.cubic_coefficients.push_back(b);
+          chan.cubic_coefficients.push_back(m0);
+          chan.cubic_coefficients.push_back(p0);
+        }
+      }
+    }
+  }
+}
+
+void animation::measure_cubic_evaluation(double& hermite_ns,
+                                         double& horner_ns) const {
+  using clock = std::chrono::high_resolution_clock;
+  hermite_ns = horner_ns = 0;
+
+  // Evaluate each segment of the vector channels at a few time points
+  const int samples_per_segment = 16;
+  std::vector<std::pair<const channel*, keyframe_interval>> segments;
+  for (const auto& chan : channels) {
+    const auto& sampler = samplers[size_t(chan.sampler_index)];
+    if (chan.cubic_coefficients.empty() ||
+        (chan.mode != channel::path::translation &&
+         chan.mode != channel::path::scale))
+      continue;
+
+    for (size_t frame = 0; frame + 1 < sampler.keyframes.size(); ++frame) {
+      keyframe_interval interval;
+      interval.lower_frame = int(frame);
+      interval.upper_frame = int(frame + 1);
+      interval.lower_time = sampler.keyframes[frame].second;
+      interval.upper_time = sampler.keyframes[frame + 1].second;
+      interval.interpolation_value = 0;
+      segments.push_back(std::make_pair(&chan, interval));
+    }
+  }
+
+  if (segments.empty()) return;
 
-      // knowing what to interpolate, the interpolation method to use, the 2
-      // keyframe index and the interpolation value, we can then calculate
-      // and apply the channel target
+  float checksum = 0;
 
-      apply_channel_target_for_interpolation_value(
-          interpolation_value, sampler.mode, lower_frame, upper_frame,
-          lower_time, upper_time, channel);
+  // From the keyframes, like the glTF specification writes it
+  auto start = clock::now();
+  for (auto segment : segments) {
+    for (int i = 0; i < samples_per_segment; ++i) {
+      segment.second.interpolation_value =
+          float(i) / float(samples_per_segment);
+      checksum += interpolate_hermite(*segment.first, segment.second)
+                      .motion.translation.x;
     }
   }
+  const auto hermite = clock::now() - start;
+
+  // From the precomputed coefficients
+  start = clock::now();
+  for (auto segment : segments) {
+    for (int i = 0; i < samples_per_segment; ++i) {
+      segment.second.interpolation_value =
+          float(i) / float(samples_per_segment);
+      checksum += interpolate(*segment.first,
+                              sampler::interpolation::cubic_spline,
+                              segment.second)
+                      .motion.translation.x;
+    }
+  }
+  const auto horner = clock::now() - start;
+
+  // Keep the evaluations from being optimized away
+  volatile float sink = checksum;
+  (void)sink;
+
+  const double nb_evaluations = double(segments.size()) * samples_per_segment;
+  hermite_ns =
+      double(std::chrono::duration_cast<std::chrono::nanoseconds>(hermite)
+                 .count()) /
+      nb_evaluations;
+  horner_ns =
+      double(std::chrono::duration_cast<std::chrono::nanoseconds>(horner)
+                 .count()) /
+      nb_evaluations;
 }
 
-void animation::apply_channel_target_for_interpolation_value(
-    float interpolation_value, sampler::interpolation mode, int lower_frame,
-    int upper_frame, float lower_time, float upper_time, const channel& chan) {
-  if (!chan.target_graph_node) return;
+animation::channel::keyframe_content animation::interpolate_hermite(
+    const channel& chan, const keyframe_interval& interval) {
+  const auto frame_delta = interval.upper_time - interval.lower_time;
+  const size_t lower = 3 * size_t(interval.lower_frame);
+  const size_t upper = 3 * size_t(interval.upper_frame);
+  const auto& p0 = chan.keyframes[lower + 1].second.motion;
+  const auto& m0 = chan.keyframes[lower + 2].second.motion;
+  const auto& m1 = chan.keyframes[upper + 0].second.motion;
+  const auto& p1 = chan.keyframes[upper + 1].second.motion;
+
+  channel::keyframe_content result;
+  if (chan.mode == channel::path::rotation)
+    result.motion.rotation = glm::normalize(cubic_spline_interpolate(
+        interval.interpolation_value, p0.rotation, frame_delta * m0.rotation,
+        p1.rotation, frame_delta * m1.rotation));
+  else
+    result.motion.translation = cubic_spline_interpolate(
+        interval.interpolation_value, p0.translation,
+        frame_delta * m0.translation, p1.translation,
+        frame_delta * m1.translation);
+  return result;
+}
+
+animation::channel::keyframe_content animation::interpolate(
+    const channel& chan, sampler::interpolation mode,
+    const keyframe_interval& interval) const {
+  channel::keyframe_content result;
+
   switch (mode) {
+    // just use the lower keyframe state
     case sampler::interpolation::step:
-      apply_step(chan, lower_frame);
-      break;
-    case sampler::interpolation::linear:
-      apply_linear(chan, lower_frame, upper_frame, interpolation_value);
-      break;
-    case sampler::interpolation::cubic_spline:
-      apply_cubic_spline(interpolation_value, lower_frame, upper_frame,
-                         lower_time, upper_time, chan);
+      result = chan.keyframes[size_t(interval.lower_frame)].second;
       break;
+
+    // just glm::mix all of the components for vectors, and slerp for
+    // quaternions
+    case sampler::interpolation::linear: {
+      const auto& lower = chan.keyframes[size_t(interval.lower_frame)].second;
+      const auto& upper = chan.keyframes[size_t(interval.upper_frame)].second;
+      const float mix = interval.interpolation_value;
+
+      if (chan.mode == channel::path::rotation)
+        result.motion.rotation = glm::normalize(
+            glm::slerp(lower.motion.rotation, upper.motion.rotation, mix));
+      else
+        result.motion.translation = glm::mix(lower.motion.translation,
+                                             upper.motion.translation, mix);
+    } break;
+
+    // Horner evaluation of the segment polynomial, see
+    // compute_cubic_coefficients()
+    case sampler::interpolation::cubic_spline: {
+      const auto* c = &chan.cubic_coefficients[4 * size_t(interval.lower_frame)];
+      const float t = interval.interpolation_value;
+      const glm::vec4 v = ((c[0] * t + c[1]) * t + c[2]) * t + c[3];
+
+      if (chan.mode == channel::path::rotation)
+        result.motion.rotation = glm::normalize(glm::quat(v.w, v.x, v.y, v.z));
+      else
+        result.motion.translation = glm::vec3(v);
+    } break;
+
     case sampler::interpolation::not_assigned:
       break;
   }
+
+  return result;
+}
+
+bool animation::sample_compressed(const channel& chan, float time,
+                                  channel::keyframe_content& value) {
+  const auto& track = chan.compressed;
+  if (time < track.times.front() || time > track.times.back()) return false;
+
+  // First key that is strictly after `time`
+  const auto upper_it =
+      std::upper_bound(track.times.begin(), track.times.end(), time);
+  const size_t upper =
+      std::min(size_t(upper_it - track.times.begin()), track.times.size() - 1);
+  const size_t lower = upper > 0 ? upper - 1 : 0;
+
+  const float span = track.times[upper] - track.times[lower];
+  const float mix = (track.step || span <= 0.f)
+                        ? 0.f
+                        : (time - track.times[lower]) / span;
+
+  const uint16_t* lower_key = &track.data[3 * lower];
+  const uint16_t* upper_key = &track.data[3 * upper];
+
+  if (chan.mode == channel::path::rotation) {
+    const glm::quat q0 = unpack_quaternion_smallest_three(lower_key);
+    if (mix == 0.f) {
+      value.motion.rotation = q0;
+    } else {
+      const glm::quat q1 = unpack_quaternion_smallest_three(upper_key);
+      value.motion.rotation = glm::normalize(glm::slerp(q0, q1, mix));
+    }
+  } else {
+    const glm::vec3 v0 =
+        unpack_quantized_vector(lower_key, track.range_min, track.range_extent);
+    if (mix == 0.f) {
+      value.motion.translation = v0;
+    } else {
+      const glm::vec3 v1 = unpack_quantized_vector(upper_key, track.range_min,
+                                                   track.range_extent);
+      value.motion.translation = glm::mix(v0, v1, mix);
+    }
+  }
+
+  return true;
 }
 
-void animation::apply_step(const channel& chan, int lower_keyframe) {
+void animation::write_channel_target(const channel& chan,
+                                     const channel::keyframe_content& value) {
   switch (chan.mode) {
-    case channel::path::weight: {
-      const auto nb_weights = chan.target_graph_node->pose.blend_weights.size();
-      for (int w = 0; w < int(nb_weights); ++w)
-        chan.target_graph_node->pose.blend_weights[size_t(w)] =
-            chan.keyframes[size_t(lower_keyframe * int(nb_weights) + w)]
-                .second.motion.weight;
-    } break;
     case channel::path::translation:
-      chan.target_graph_node->pose.translation =
-          chan.keyframes[size_t(lower_keyframe)].second.motion.translation;
+      chan.target_graph_node->set_pose_translation(value.motion.translation);
       break;
     case channel::path::scale:
-      chan.target_graph_node->pose.scale =
-          chan.keyframes[size_t(lower_keyframe)].second.motion.scale;
+      chan.target_graph_node->set_pose_scale(value.motion.scale);
       break;
     case channel::path::rotation:
-      chan.target_graph_node->pose.rotation =
-          chan.keyframes[size_t(lower_keyframe)].second.motion.rotation;
+      chan.target_graph_node->set_pose_rotation(value.motion.rotation);
       break;
+    case channel::path::weight:
     case channel::path::not_assigned:
       break;
   }
 }
 
-void animation::apply_linear(const channel& chan, int lower_keyframe,
-                             int upper_keyframe, float mix) {
-  switch (chan.mode) {
-    case channel::path::weight: {
-      const auto nb_weights = chan.target_graph_node->pose.blend_weights.size();
-      for (int w = 0; w < int(nb_weights); ++w) {
-        chan.target_graph_node->pose.blend_weights[size_t(w)] =
-            glm::mix(chan.keyframes[size_t(lower_keyframe * int(nb_weights) + w)]
-                         .second.motion.weight,
-                     chan.keyframes[size_t(upper_keyframe * int(nb_weights) + w)]
-                         .second.motion.weight,
-                     mix);
-      }
-    } break;
-    case channel::path::translation: {
-      glm::vec3 lower_translation =
-          chan.keyframes[size_t(lower_keyframe)].second.motion.translation;
-      glm::vec3 upper_translation =
-          chan.keyframes[size_t(upper_keyframe)].second.motion.translation;
-      glm::vec3 result = glm::mix(lower_translation, upper_translation, mix);
-
-      chan.target_graph_node->pose.translation = result;
-    } break;
-    case channel::path::scale: {
-      glm::vec3 lower_scale =
-          chan.keyframes[size_t(lower_keyframe)].second.motion.scale;
-      glm::vec3 upper_scale =
-          chan.keyframes[size_t(upper_keyframe)].second.motion.scale;
-      glm::vec3 result = glm::mix(lower_scale, upper_scale, mix);
-
-      chan.target_graph_node->pose.scale = result;
-    } break;
-    case channel::path::rotation: {
-      glm::quat lower_rotation =
-          chan.keyframes[size_t(lower_keyframe)].second.motion.rotation;
-      glm::quat upper_rotation =
-          chan.keyframes[size_t(upper_keyframe)].second.motion.rotation;
-      glm::quat result = glm::slerp(lower_rotation, upper_rotation, mix);
-
-      chan.target_graph_node->pose.rotation = glm::normalize(result);
-
-    } break;
-    // nothing to do here for us in this case...
-    case channel::path::not_assigned:
-      break;
-  }
+size_t animation::weight_count(const channel& chan) const {
+  const auto& sampler = samplers[size_t(chan.sampler_index)];
+  if (sampler.keyframes.empty()) return 0;
+  const size_t per_key = chan.keyframes.size() / sampler.keyframes.size();
+  return sampler.mode == sampler::interpolation::cubic_spline ? per_key / 3
+                                                              : per_key;
 }
 
-inline int input_tangent(int frame) { return 3 * frame + 0; }
-
-inline int output_tangent(int frame) { return 3 * frame + 2; }
-
-inline int value(int frame) { return 3 * frame + 1; }
-
-void animation::apply_cubic_spline(float interpolation_value, int lower_frame,
-                                   int upper_frame, float lower_time,
-                                   float upper_time, const channel& chan) {
-  /*
-   * When the sampler is set to cubic spline interpolation, each keyframe in
-   * the channel is actually composed of 3 elements :
-   *
-   *  - An Input Tangent
-   *  - The value at the keyframe
-   *  - An output Tangent
-   *
-   *  The "channel" array is thus 3 times bigger than the number of keyframes
-   * defined in the sampler.
-   *
-   *  To make the retrial code a bit more explicit, the 3 functions declared
-   * above return the index of the element in the array that correspond to the
-   * name of the function, given the keyframe index
-   *
-   *  The input and output tangent needs to be scaled by the keyframe duration
-   * (upper_time - lower_time), the define the level of "cubic smoothing"
-   * around the time point.
-   *
-   *  To interpolate the value at "current time" we need the point
-   * corresponding to the lower and upper frame (p0 and p1) and we need the
-   * output tangent of the lower frame, and the input tangent of the upper
-   * frame.
-   *
-   *  The scaled values are called m0 and m1 in the glTF specification
-   * (Appendix C).
-   *
-   */
-
-  const auto frame_delta = upper_time - lower_time;
-
-  // Retrieve data
-  const auto p0 = chan.keyframes[size_t(value(lower_frame))];
-  const auto unscaled_m0 = chan.keyframes[size_t(output_tangent(lower_frame))];
-  const auto unscaled_m1 = chan.keyframes[size_t(input_tangent(upper_frame))];
-  const auto p1 = chan.keyframes[size_t(value(upper_frame))];
-  // m0 and m1 need to be scaled by this value (delta between the 2 keyframes
-  // being interpolated)
-
-  switch (chan.mode) {
-    case channel::path::weight: {
-      const auto nb_weights = chan.target_graph_node->pose.blend_weights.size();
-      for (int w = 0; w < int(nb_weights); ++w) {
-        chan.target_graph_node->pose.blend_weights[size_t(w)] =
-            cubic_spline_interpolate(
-                interpolation_value, p0.second.motion.weight,
-                frame_delta * unscaled_m0.second.motion.weight,
-                p1.second.motion.weight,
-                frame_delta * unscaled_m1.second.motion.weight);
-      }
-    } break;
-    case channel::path::translation: {
-      chan.target_graph_node->pose.translation = cubic_spline_interpolate(
-          interpolation_value, p0.second.motion.translation,
-          frame_delta * unscaled_m0.second.motion.translation,
-          p1.second.motion.translation,
-          frame_delta * unscaled_m1.second.motion.translation);
-
-    } break;
-    case channel::path::scale: {
-      chan.target_graph_node->pose.scale = cubic_spline_interpolate(
-          interpolation_value, p0.second.motion.scale,
-          frame_delta * unscaled_m0.second.motion.scale, p1.second.motion.scale,
-          frame_delta * unscaled_m1.second.motion.scale);
-    } break;
-    case channel::path::rotation: {
-      chan.target_graph_node->pose.rotation = cubic_spline_interpolate(
-          interpolation_value, p0.second.motion.rotation,
-          frame_delta * unscaled_m0.second.motion.rotation,
-          p1.second.motion.rotation,
-          frame_delta * unscaled_m1.second.motion.rotation);
-    } break;
-    case channel::path::not_assigned: {
-    } break;
+bool animation::sample_weights(const channel& chan, float time, float* weights,
+                               size_t nb_weights) const {
+  const auto& sampler = samplers[size_t(chan.sampler_index)];
+  keyframe_interval interval;
+  if (!find_keyframe_interval(sampler, time, interval)) return false;
+
+  // Weights of one keyframe are stored contiguously
+  const size_t stride = weight_count(chan);
+  const auto weight_at = [&](int keyframe, size_t w) {
+    return chan.keyframes[size_t(keyframe) * stride + w].second.motion.weight;
+  };
+
+  for (size_t w = 0; w < std::min(nb_weights, stride); ++w) {
+    float& weight = weights[w];
+    switch (sampler.mode) {
+      case sampler::interpolation::step:
+        weight = weight_at(interval.lower_frame, w);
+        break;
+      case sampler::interpolation::linear:
+        weight = glm::mix(weight_at(interval.lower_frame, w),
+                          weight_at(interval.upper_frame, w),
+                          interval.interpolation_value);
+        break;
+      case sampler::interpolation::cubic_spline: {
+        const auto& c =
+            chan.cubic_coefficients[size_t(interval.lower_frame) * stride + w];
+        const float t = interval.interpolation_value;
+        weight = ((c.x * t + c.y) * t + c.z) * t + c.w;
+      } break;
+      case sampler::interpolation::not_assigned:
+        break;
+    }
   }
+
+  return true;
 }
 
 animation::sampler::sampler()
@@ -324,8 +537,17 @@ animation::channel::keyframe_content::keyframe_content() {
   std::memset(this, 0, sizeof(keyframe_content));
 }
 
+animation::channel::compressed_track::compressed_track()
+    : range_min(0.f), range_extent(0.f), step(false) {}
+
+size_t animation::channel::compressed_track::byte_size() const {
+  return times.size() * sizeof(float) + data.size() * sizeof(uint16_t) +
+         sizeof(range_min) + sizeof(range_extent);
+}
+
 animation::channel::channel()
-    : sampler_index(-1),
+    : is_static(false),
+      sampler_index(-1),
       target_node(-1),
       target_graph_node(nullptr),
       mode(path::not_assigned) {}
@@ -24,7 +24,9 @@ SOFTWARE.
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -42,6 +44,7 @@ SOFTWARE.
 #endif
 
 struct gltf_node;
+struct pose_cache;
 
 #define ANIMATION_FPS 60.0f
 
@@ -75,6 +78,40 @@ struct animation {
     /// Storage for keyframes, they are stored with their frame index
     std::vector<std::pair<int, keyframe_content>> keyframes;
 
+    /// Lossy representation of a translation, rotation or scale channel. This
+    /// is filled by `compress_animation()` (see animation-compression.hh). When
+    /// it is not empty, `keyframes` has been released and the channel is
+    /// sampled from here instead.
+    struct compressed_track {
+      /// Time point of each key that survived the curve fitting
+      std::vector<float> times;
+
+      /// 3 words per key. Rotations are stored as "smallest three" 48bit
+      /// quaternions, translations and scales are quantized in the range below
+      std::vector<uint16_t> data;
+
+      /// Quantization range of translation and scale keys
+      glm::vec3 range_min, range_extent;
+
+      /// Set when the original sampler was STEP, keys are not interpolated
+      bool step;
+
+      compressed_track();
+      bool empty() const { return times.empty(); }
+      size_t byte_size() const;
+    } compressed;
+
+    /// Set by `fold_animations()` when the channel never changes. Only the
+    /// value of the first keyframe is kept, and it is applied once.
+    bool is_static;
+
+    /// Polynomial form of each segment of a CUBICSPLINE channel, built by
+    /// `animation::compute_cubic_coefficients()`. Holds the a, b, c, d
+    /// coefficients of a t^3 + b t^2 + c t + d, as 4 consecutive vectors per
+    /// segment (xyzw of a quaternion, or xyz of a vector), or as a single
+    /// vector per segment and per morph target weight.
+    std::vector<glm::vec4> cubic_coefficients;
+
     /// Index of the sampler to be used
     int sampler_index;
 
@@ -122,6 +159,34 @@ struct animation {
   /// Name of the animation
   std::string name;
 
+  /// Incremented when the keyframes are edited, so derived data can be
+  /// rebuilt
+  int revision;
+
+  /// When set, poses are read from this table instead of being evaluated from
+  /// the keyframes. See pose-cache.hh
+  std::shared_ptr<const pose_cache> baked_poses;
+
+  /// Statistics about the lossless folding of this animation
+  struct folding_report {
+    size_t removed_keys = 0;
+    int static_channels = 0;
+  } folding;
+
+  /// Number of channels that had nothing to apply during the last
+  /// `apply_pose()` call (no target, or current time out of their range)
+  int inert_channels;
+
+  /// Statistics about the lossy compression of this animation
+  struct compression_report {
+    bool compressed = false;
+    size_t raw_bytes = 0, compressed_bytes = 0;
+    size_t raw_keys = 0, compressed_keys = 0;
+    int compressed_channels = 0, skipped_channels = 0;
+    /// Largest error measured on a joint, in scene units
+    float max_error = 0;
+  } compression;
+
   /// Set the current play state of the animation
   void set_playing_state(bool state = true);
 
@@ -140,22 +205,72 @@ struct animation {
   /// Assign to each animation channel a pointer to the node they control
   void set_gltf_graph_targets(gltf_node* root_node);
 
+  /// Precompute the polynomial form of the cubic spline channels. Needs to
+  /// be called again if the keyframes are modified
+  void compute_cubic_coefficients();
+
+  /// Time the evaluation of the cubic spline segments of this animation, from
+  /// the keyframes and from the precomputed coefficients. In nanoseconds per
+  /// evaluation
+  void measure_cubic_evaluation(double& hermite_ns, double& horner_ns) const;
+
   /// Apply the pose at "current time" to the animated objects
   void apply_pose();
 
+  /// Evaluate a translation, rotation or scale channel at the given time
+  /// without touching the animated node. Return false if the channel has no
+  /// value at this time point.
+  bool sample_channel(const channel& chan, float time,
+                      channel::keyframe_content& value) const;
+
+  /// Evaluate a morph target weight channel at the given time into `weights`,
+  /// without touching the animated node. Return false if the channel has no
+  /// value at this time point.
+  bool sample_weights(const channel& chan, float time, float* weights,
+                      size_t nb_weights) const;
+
+  /// Number of morph target weights animated by a weight channel
+  size_t weight_count(const channel& chan) const;
+
  private:
-  /// Apply the pose in the animation channel for the given interpolation mode
-  void apply_channel_target_for_interpolation_value(
-      float interpolation_value, sampler::interpolation mode, int lower_frame,
-      int upper_frame, float lower_time, float upper_time, const channel& chan);
+  /// The two keyframes surrounding a time point, and where we are between them
+  struct keyframe_interval {
+    int lower_frame, upper_frame;
+    float lower_time, upper_time;
+    /// In the [0; 1] range
+    float interpolation_value;
+  };
+
+  /// Static channels only need to be written once
+  bool static_pose_applied;
+
+  /// Check if the channel has a value at this time point
+  bool channel_covers(const channel& chan, float time) const;
 
-  /// just apply the lower keyframe state
-  void apply_step(const channel& chan, int lower_keyframe);
+  /// Write the value of a static channel to the node it animates
+  static void apply_static_channel(const channel& chan);
 
-  /// just glm::mix all of the components for vectors, and slerp for
-  /// quaternions?
-  void apply_linear(const channel& chan, int lower_keyframe, int upper_keyframe,
-                    float mix);
+  /// Search the 2 keyframes that we need to interpolate between
+  static bool find_keyframe_interval(const sampler& s, float time,
+                                     keyframe_interval& interval);
+
+  /// Interpolate the translation, rotation or scale stored in the keyframes
+  channel::keyframe_content interpolate(const channel& chan,
+                                        sampler::interpolation mode,
+                                        const keyframe_interval& interval) const;
+
+  /// Evaluate a cubic spline segment straight from the keyframes. Only used
+  /// as a reference by `measure_cubic_evaluation()`
+  static channel::keyframe_content interpolate_hermite(
+      const channel& chan, const keyframe_interval& interval);
+
+  /// Decode the value stored in the compressed track of the channel
+  static bool sample_compressed(const channel& chan, float time,
+                                channel::keyframe_content& value);
+
+  /// Write the value of the channel to the node it animates
+  static void write_channel_target(const channel& chan,
+                                   const channel::keyframe_content& value);
 
   /// Compute the cubic spline interpolation
   /// See
@@ -168,9 +283,4 @@ struct animation {
     return (2 * t3 - 3 * t2 + 1) * p0 + (t3 - 2 * t2 + t) * m0 +
            (-2 * t3 + 3 * t2) * p1 + (t3 - t2) * m1;
   }
-
-  /// Apply cubic spline sampling
-  void apply_cubic_spline(float interpolation_value, int lower_frame,
-                          int upper_frame, float lower_time, float upper_time,
-                          const channel& chan);
 };
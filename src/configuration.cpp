@@ -14,6 +14,11 @@ glm::vec4 configuration::bone_highlight_color = glm::vec4(0.5, 0, 0.5, 1);
 glm::vec4 configuration::joint_highlight_color = glm::vec4(0, 1, 0, 1);
 float configuration::bone_draw_size = 3;
 float configuration::joint_draw_size = 3;
+bool configuration::fold_animation_keys = true;
+bool configuration::compress_animations = false;
+float configuration::animation_compression_tolerance = 0.001f;
+bool configuration::bake_pose_cache = false;
+int configuration::parallel_transform_threshold = 20000;
 bool configuration::editor_configuration_open = false;
 
 void configuration::show_editor_configuration_window() {
@@ -31,6 +36,16 @@ void configuration::show_editor_configuration_window() {
     ImGui::ColorEdit3("Joint (selected)",
                       glm::value_ptr(joint_highlight_color));
     ImGui::SliderFloat("Joint size", &joint_draw_size, 1, 10);
+    ImGui::TextColored(yellow, "Animation (applied on next load):");
+    ImGui::Checkbox("Fold constant channels and redundant keys",
+                    &fold_animation_keys);
+    ImGui::Checkbox("Compress animations", &compress_animations);
+    ImGui::InputFloat("Compression tolerance",
+                      &animation_compression_tolerance, 0, 0, "%.5f");
+    ImGui::Checkbox("Bake pose cache for scrubbing", &bake_pose_cache);
+    ImGui::TextColored(yellow, "Scene:");
+    ImGui::InputInt("Nodes to update transforms in parallel",
+                    &parallel_transform_threshold, 1000, 10000);
   }
   ImGui::End();
 }
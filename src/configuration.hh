@@ -12,6 +12,11 @@ struct configuration {
   static glm::vec4 bone_highlight_color;
   static float joint_draw_size;
   static float bone_draw_size;
+  static bool fold_animation_keys;
+  static bool compress_animations;
+  static float animation_compression_tolerance;
+  static bool bake_pose_cache;
+  static int parallel_transform_threshold;
   static bool editor_configuration_open;
   static void show_editor_configuration_window();
 
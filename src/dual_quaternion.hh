@@ -0,0 +1,66 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#include "affine.hh"
+
+/// Rigid transform stored as a unit dual quaternion. Both parts are stored as
+/// (x, y, z, w), so a joint fits in 2 vec4 uniforms.
+struct dual_quaternion {
+  /// The rotation
+  glm::vec4 real;
+  /// Half the translation, multiplied by the rotation
+  glm::vec4 dual;
+};
+
+/// Convert the rigid part of an affine transform. The scale and shear of the
+/// linear part are dropped.
+inline dual_quaternion dual_quaternion_from_affine(const affine& a) {
+  glm::mat3 rotation;
+  for (int column = 0; column < 3; ++column)
+    rotation[column] = glm::normalize(glm::vec3(
+        a.rows[0][column], a.rows[1][column], a.rows[2][column]));
+  const glm::quat r = glm::quat_cast(rotation);
+  const glm::vec3 t(a.rows[0].w, a.rows[1].w, a.rows[2].w);
+
+  // dual = 0.5 * (t, 0) * r
+  const glm::vec3 axis(r.x, r.y, r.z);
+  dual_quaternion dq;
+  dq.real = glm::vec4(axis, r.w);
+  dq.dual = glm::vec4(0.5f * (r.w * t + glm::cross(t, axis)),
+                      -0.5f * glm::dot(t, axis));
+  return dq;
+}
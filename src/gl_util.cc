@@ -25,6 +25,7 @@ SOFTWARE.
 #ifdef __EMSCRIPTEN__
 #include <GLES3/gl3.h>
 #endif
+#include <cassert>
 #include <cstring>
 #include <iostream>
 
@@ -222,8 +223,7 @@ void draw_space_base(GLuint shader, const float line_width,
             glm::vec4(0, 0, 1, 1), line_width);
 }
 
-void load_shaders(const size_t nb_joints,
-                  std::map<std::string, shader>& shaders) {
+void load_shaders(std::map<std::string, shader>& shaders) {
   //"paste in" the bundled shader code
 #include "base_color_map.frag_inc.hh"
 #include "draw_debug_color.frag_inc.hh"
@@ -235,45 +235,18 @@ void load_shaders(const size_t nb_joints,
 #include "occlusion_map.frag_inc.hh"
 #include "pbr_metallic_roughness.frag_inc.hh"
 #include "perturbed_normal.frag_inc.hh"
-#include "skinning_template.vert_inc.hh"
 #include "unlit.frag_inc.hh"
 #include "uv.frag_inc.hh"
 #include "vertex_color.frag_inc.hh"
 #include "weights.frag_inc.hh"
 #include "world_fragment.frag_inc.hh"
 
-  // print some warnings
-  if (nb_joints > 180)
-    std::cerr << "Warning: This is a lot of joints, model may be unsuited for "
-                 "GPU based skinning.\n//TODO investigate dual quaternion "
-                 "based skinning\n";
-
   // TODO put the GLSL code ouside of here, load them from files
   // Main vertex shader, that perform GPU skinning
 
   const std::string no_skinning_vert_src(
       reinterpret_cast<char*>(no_skinning_vert), no_skinning_vert_len);
 
-  const std::string skinning_vert_src = [&] {
-    // TODO a real shader template system may be useful
-    // Write in shader source code the value of `nb_joints`
-    std::string skinning_template_vert_src(
-        reinterpret_cast<char*>(skinning_template_vert),
-        skinning_template_vert_len);
-    size_t index = skinning_template_vert_src.find("$nb_joints");
-    if (index == std::string::npos) {
-      std::cerr
-          << "The skinned mesh vertex shader doesn't have the $nb_joints "
-             "token in it's source code anywhere. We cannot do skinning on "
-             "a shader that cannot receive the joint list.\n";
-      exit(EXIT_FAILURE);
-    }
-
-    skinning_template_vert_src.replace(index, strlen("$nb_joints"),
-                                       std::to_string(nb_joints));
-    return skinning_template_vert_src;
-  }();
-
   const std::string unlit_frag_src(reinterpret_cast<char*>(unlit_frag),
                                    unlit_frag_len);
   const std::string draw_debug_color_src(
@@ -305,15 +278,12 @@ void load_shaders(const size_t nb_joints,
                                    world_fragment_frag_len);
   const std::string vertex_color_frag_src(
       reinterpret_cast<char*>(vertex_color_frag), vertex_color_frag_len);
-  const std::string& vert_src =
-      nb_joints != 0 ? skinning_vert_src : no_skinning_vert_src;
+  const std::string& vert_src = no_skinning_vert_src;
 
   shaders["unlit"] = shader("unlit", vert_src, unlit_frag_src);
   shaders["debug_color"] =
       shader("debug_color", no_skinning_vert_src, draw_debug_color_src);
-  shaders["debug_uv"] = shader(
-      "debug_uv", nb_joints != 0 ? skinning_vert_src : no_skinning_vert_src,
-      uv_frag_src);
+  shaders["debug_uv"] = shader("debug_uv", vert_src, uv_frag_src);
   shaders["debug_normals"] =
       shader("debug_normals", vert_src, normals_frag_src);
   shaders["debug_normal_map"] =
@@ -338,28 +308,166 @@ void load_shaders(const size_t nb_joints,
   shaders["weights"] = shader("weights", vert_src, weights_frag_src);
 }
 
-void update_uniforms(std::map<std::string, shader>& shaders, bool use_ibl,
-                     const glm::vec3& camera_position,
+/// Build the deformation pass with `defines` before its source
+static shader load_deformation_pass_shader(const char* name,
+                                           const std::string& defines) {
+#include "skinning_pass.frag_inc.hh"
+#include "skinning_pass.vert_inc.hh"
+
+  const std::string vert_src =
+      "#define MAX_MORPH_TARGETS " + std::to_string(max_gpu_morph_targets) +
+      "\n" + defines +
+      std::string(reinterpret_cast<char*>(skinning_pass_vert),
+                  skinning_pass_vert_len);
+  const std::string frag_src(reinterpret_cast<char*>(skinning_pass_frag),
+                             skinning_pass_frag_len);
+
+  shader program(name, vert_src, frag_src,
+                 {"skinned_position", "skinned_normal"});
+
+  // Every sampler gets its own unit once and for all. Left on the default unit
+  // 0, the integer morph_deltas would share it with the float samplers, that
+  // GL forbids at the draw, even for the samplers the submesh does not read.
+  program.use();
+  program.set_uniform("influence_offsets", texture_unit_influence_offsets);
+  program.set_uniform("influences", texture_unit_influences);
+  program.set_uniform("joint_palette", texture_unit_joint_palette);
+  program.set_uniform("morph_deltas", texture_unit_morph_deltas);
+  glUseProgram(0);
+  return program;
+}
+
+/// Half float deltas are read as floats, int16 ones need an integer sampler
+static std::string morph_delta_defines(morph_delta_format deltas) {
+  return deltas == morph_delta_format::int16 ? "#define INTEGER_MORPH_DELTAS\n"
+                                             : "";
+}
+
+shader load_skinning_pass_shader(skinning_method method,
+                                 morph_delta_format deltas) {
+  // The joints are read from a texture, so the same shader works for any
+  // number of joints. Only the blending method is chosen at compile time.
+  return load_deformation_pass_shader(
+      "skinning_pass", morph_delta_defines(deltas) +
+                           (method == skinning_method::dual_quaternion
+                                ? "#define DUAL_QUATERNION_SKINNING\n"
+                                : ""));
+}
+
+shader load_morph_pass_shader(morph_delta_format deltas) {
+  return load_deformation_pass_shader(
+      "morph_pass", morph_delta_defines(deltas) + "#define NO_SKINNING\n");
+}
+
+draw_uniforms::draw_uniforms(const shader& program)
+    : active_vertex(program.get_uniform<glm::vec3>("active_vertex")),
+      camera_position(program.get_uniform<glm::vec3>("camera_position")),
+      light_direction(program.get_uniform<glm::vec3>("light_direction")),
+      light_color(program.get_uniform<glm::vec3>("light_color")),
+      active_joint(program.get_uniform<int>("active_joint")),
+      use_ibl(program.get_uniform<int>("use_ibl")),
+      mvp(program.get_uniform<glm::mat4>("mvp")),
+      model(program.get_uniform<glm::mat4>("model")),
+      normal(program.get_uniform<glm::mat3>("normal")),
+      debug_color(program.get_uniform<glm::vec4>("debug_color")),
+      material(program) {}
+
+void load_draw_uniforms(const std::map<std::string, shader>& shaders,
+                        std::map<std::string, draw_uniforms>& uniforms) {
+  uniforms.clear();
+  for (const auto& program : shaders)
+    uniforms[program.first] = draw_uniforms(program.second);
+}
+
+void update_uniforms(const shader& program, const draw_uniforms& uniforms,
+                     bool use_ibl, const glm::vec3& camera_position,
                      const glm::vec3& light_color,
                      const glm::vec3& light_direction, const int active_joint,
-                     const std::string& shader_to_use, const glm::mat4& model,
-                     const glm::mat4& mvp, const glm::mat3& normal,
-                     const std::vector<glm::mat4>& joint_matrices,
-                     const glm::vec3& active_vertex) {
-  shaders[shader_to_use].use();
-  shaders[shader_to_use].set_uniform("active_vertex", active_vertex);
-  shaders[shader_to_use].set_uniform("camera_position", camera_position);
-  shaders[shader_to_use].set_uniform("light_direction", light_direction);
-  shaders[shader_to_use].set_uniform("light_color", light_color);
-  shaders[shader_to_use].set_uniform("active_joint", active_joint);
-  shaders[shader_to_use].set_uniform("joint_matrix", joint_matrices);
-  shaders[shader_to_use].set_uniform("mvp", mvp);
-  shaders[shader_to_use].set_uniform("model", model);
-  shaders[shader_to_use].set_uniform("normal", normal);
-  shaders[shader_to_use].set_uniform("debug_color",
-                                     glm::vec4(0.5f, 0.5f, 0.f, 1.f));
-  shaders[shader_to_use].set_uniform("use_ibl",
-                                     int(use_ibl ? GL_TRUE : GL_FALSE));
+                     const glm::mat4& model, const glm::mat4& mvp,
+                     const glm::mat3& normal, const glm::vec3& active_vertex) {
+  program.use();
+  program.set_uniform(uniforms.active_vertex, active_vertex);
+  program.set_uniform(uniforms.camera_position, camera_position);
+  program.set_uniform(uniforms.light_direction, light_direction);
+  program.set_uniform(uniforms.light_color, light_color);
+  program.set_uniform(uniforms.active_joint, active_joint);
+  program.set_uniform(uniforms.mvp, mvp);
+  program.set_uniform(uniforms.model, model);
+  program.set_uniform(uniforms.normal, normal);
+  program.set_uniform(uniforms.debug_color, glm::vec4(0.5f, 0.5f, 0.f, 1.f));
+  program.set_uniform(uniforms.use_ibl, int(use_ibl ? GL_TRUE : GL_FALSE));
+}
+
+/// Upload `size` values of `value_size` bytes, `components` per texel
+static void upload_data_texture(GLuint& texture, const void* data, size_t size,
+                                int components, size_t value_size,
+                                GLint internal_format, GLenum format,
+                                GLenum type) {
+  assert(size % size_t(components) == 0);
+  const auto bytes = static_cast<const uint8_t*>(data);
+
+  const size_t width = size_t(data_texture_width);
+  const size_t texels = size / size_t(components);
+  const size_t full_rows = texels / width;
+  const size_t last_row = texels % width;
+  const size_t rows = std::max<size_t>(1, full_rows + (last_row != 0 ? 1 : 0));
+
+  if (texture == 0) glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  // Specifying the storage again gives the driver a fresh one, instead of
+  // waiting for the draws that still read the previous content. The texels
+  // past the end of the data are left undefined.
+  glTexImage2D(GL_TEXTURE_2D, 0, internal_format, data_texture_width,
+               GLsizei(rows), 0, format, type, nullptr);
+  if (full_rows > 0)
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data_texture_width,
+                    GLsizei(full_rows), format, type, bytes);
+  if (last_row > 0)
+    glTexSubImage2D(
+        GL_TEXTURE_2D, 0, 0, GLint(full_rows), GLsizei(last_row), 1, format,
+        type, bytes + full_rows * width * size_t(components) * value_size);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void upload_data_texture(GLuint& texture, const std::vector<float>& data,
+                         int components) {
+  upload_data_texture(texture, data.data(), data.size(), components);
+}
+
+void upload_data_texture(GLuint& texture, const float* data, size_t size,
+                         int components) {
+  static const GLint internal_formats[] = {GL_R32F, GL_RG32F, GL_RGB32F,
+                                           GL_RGBA32F};
+  static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  assert(components >= 1 && components <= 4);
+  upload_data_texture(texture, data, size, components, sizeof(float),
+                      internal_formats[components - 1],
+                      formats[components - 1], GL_FLOAT);
+}
+
+void upload_data_texture(GLuint& texture, const std::vector<uint16_t>& data,
+                         int components, bool integer) {
+  static const GLint half_formats[] = {GL_R16F, GL_RG16F, GL_RGB16F,
+                                       GL_RGBA16F};
+  static const GLint integer_formats[] = {GL_R16I, GL_RG16I, GL_RGB16I,
+                                          GL_RGBA16I};
+  static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  static const GLenum integer_pixel_formats[] = {
+      GL_RED_INTEGER, GL_RG_INTEGER, GL_RGB_INTEGER, GL_RGBA_INTEGER};
+  assert(components >= 1 && components <= 4);
+  if (integer)
+    upload_data_texture(texture, data.data(), data.size(), components,
+                        sizeof(uint16_t), integer_formats[components - 1],
+                        integer_pixel_formats[components - 1], GL_SHORT);
+  else
+    upload_data_texture(texture, data.data(), data.size(), components,
+                        sizeof(uint16_t), half_formats[components - 1],
+                        formats[components - 1], GL_HALF_FLOAT);
 }
 
 void perform_draw_call(
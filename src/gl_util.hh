@@ -26,6 +26,7 @@ SOFTWARE.
 #include <algorithm>
 #include <map>
 #include <string>
+#include <vector>
 
 #ifndef __EMSCRIPTEN__
 #include <glad/glad.h>
@@ -35,6 +36,7 @@ SOFTWARE.
 
 #include "material.hh"
 #include "shader.hh"
+#include "skinning.hh"
 
 // These values are used to define shader varying inputs:
 static constexpr auto VBO_count = 7;
@@ -47,6 +49,20 @@ static constexpr auto VBO_layout_color = 3;
 static constexpr auto VBO_layout_joints = 4;
 static constexpr auto VBO_layout_weights = 5;
 
+// Texture units used by the vertex shaders, after the ones of the materials
+static constexpr auto texture_unit_influence_offsets = 5;
+static constexpr auto texture_unit_influences = 6;
+static constexpr auto texture_unit_joint_palette = 7;
+static constexpr auto texture_unit_morph_deltas = 8;
+
+/// Width of the data textures. Element `i` is stored in the texel
+/// (i % data_texture_width, i / data_texture_width)
+static constexpr auto data_texture_width = 4096;
+
+/// Number of morph targets the GPU morphing can blend at once on a submesh.
+/// Only the targets with a non zero weight count.
+static constexpr auto max_gpu_morph_targets = 32;
+
 struct utility_buffers {
   static GLuint point_vbo, line_vbo, point_vao, line_vao, point_ebo, line_ebo;
   static void init_static_buffers();
@@ -76,19 +92,56 @@ void draw_space_base(GLuint shader, const float line_width,
 void draw_line(GLuint shader, const glm::vec3 origin, const glm::vec3 end,
                const glm::vec4 draw_color, const float line_width);
 
-/// Load all the shaders. Skinning shader needs t
-void load_shaders(const size_t nb_joints,
-                  std::map<std::string, shader>& shaders);
+/// Load all the shaders
+void load_shaders(std::map<std::string, shader>& shaders);
+
+/// Load the shader of the GPU skinning pass, that writes the skinned position
+/// and normal of each vertex with transform feedback. It reads morph deltas
+/// stored in `deltas`.
+shader load_skinning_pass_shader(skinning_method method,
+                                 morph_delta_format deltas);
+
+/// Load the same pass without skinning, for the meshes that are only morphed
+shader load_morph_pass_shader(morph_delta_format deltas);
+
+/// Handles of the uniforms set on every draw of a mesh shader, resolved once
+/// after it is loaded
+struct draw_uniforms {
+  uniform_handle<glm::vec3> active_vertex, camera_position, light_direction,
+      light_color;
+  uniform_handle<int> active_joint, use_ibl;
+  uniform_handle<glm::mat4> mvp, model;
+  uniform_handle<glm::mat3> normal;
+  uniform_handle<glm::vec4> debug_color;
+  gltf_insight::material_uniforms material;
+
+  draw_uniforms() = default;
+  explicit draw_uniforms(const shader& program);
+};
+
+/// Resolve the draw uniforms of each shader
+void load_draw_uniforms(const std::map<std::string, shader>& shaders,
+                        std::map<std::string, draw_uniforms>& uniforms);
 
-/// Update all shader's uniforms
-void update_uniforms(std::map<std::string, shader>& shaders, bool use_ibl,
-                     const glm::vec3& camera_position,
+/// Bind `program` and update its uniforms
+void update_uniforms(const shader& program, const draw_uniforms& uniforms,
+                     bool use_ibl, const glm::vec3& camera_position,
                      const glm::vec3& light_color,
                      const glm::vec3& light_direction, const int active_joint,
-                     const std::string& shader_to_use, const glm::mat4& model,
-                     const glm::mat4& mvp, const glm::mat3& normal,
-                     const std::vector<glm::mat4>& joint_matrices,
-                     const glm::vec3& active_vertex);
+                     const glm::mat4& model, const glm::mat4& mvp,
+                     const glm::mat3& normal, const glm::vec3& active_vertex);
+
+/// Store an array of elements of 1 to 4 floats in a texture, to be read with
+/// texelFetch by a shader. The texture is created if `texture` is 0.
+void upload_data_texture(GLuint& texture, const std::vector<float>& data,
+                         int components);
+/// Same, from `size` floats, a multiple of `components`
+void upload_data_texture(GLuint& texture, const float* data, size_t size,
+                         int components);
+/// Same with 16 bit values, half floats or signed integers. The integer
+/// texture is read with an isampler2D.
+void upload_data_texture(GLuint& texture, const std::vector<uint16_t>& data,
+                         int components, bool integer);
 
 /// Info needed to actually submit drawcall for a submesh
 struct draw_call_submesh_descriptor {
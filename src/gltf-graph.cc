@@ -29,6 +29,8 @@ SOFTWARE.
 #endif
 #include "gltf-graph.hh"
 
+#include <algorithm>
+
 #include "gl_util.hh"
 #include "tiny_gltf_util.h"
 
@@ -51,6 +53,31 @@ void gltf_node::add_child() {
 
 gltf_node* gltf_node::get_ptr() { return this; }
 
+void gltf_node::set_pose_translation(const glm::vec3& translation) {
+  if (pose.translation == translation) return;
+  pose.translation = translation;
+  if (scene) scene->translations[size_t(flat_index)] = translation;
+  mark_transform_dirty();
+}
+
+void gltf_node::set_pose_rotation(const glm::quat& rotation) {
+  if (pose.rotation == rotation) return;
+  pose.rotation = rotation;
+  if (scene) scene->rotations[size_t(flat_index)] = rotation;
+  mark_transform_dirty();
+}
+
+void gltf_node::set_pose_scale(const glm::vec3& scale) {
+  if (pose.scale == scale) return;
+  pose.scale = scale;
+  if (scene) scene->scales[size_t(flat_index)] = scale;
+  mark_transform_dirty();
+}
+
+void gltf_node::mark_transform_dirty() {
+  if (scene) scene->dirty[size_t(flat_index)] = true;
+}
+
 static gltf_node* find_index_in_children(gltf_node* node, int index) {
   if (node->gltf_node_index == index) return node;
 
@@ -64,6 +91,14 @@ static gltf_node* find_index_in_children(gltf_node* node, int index) {
 }
 
 gltf_node* gltf_node::get_node_with_index(int index) {
+  if (index == gltf_node_index) return this;
+
+  // Only the root of the graph has the table
+  if (!node_index_table.empty())
+    return index >= 0 && size_t(index) < node_index_table.size()
+               ? node_index_table[size_t(index)]
+               : nullptr;
+
   auto* node = find_index_in_children(this, index);
 
   if (node) {
@@ -72,53 +107,202 @@ gltf_node* gltf_node::get_node_with_index(int index) {
   return node;
 }
 
-void update_mesh_skeleton_graph_transforms(gltf_node& node,
-                                           glm::mat4 parent_matrix) {
-  // Calculate a matrix that apply the "animated pose" transform to the node
-  const glm::mat4 pose_translation =
-      glm::translate(glm::mat4(1.f), node.pose.translation);
-  const glm::mat4 pose_rotation = glm::toMat4(node.pose.rotation);
-  const glm::mat4 pose_scale = glm::scale(glm::mat4(1.f), node.pose.scale);
-
-  glm::mat4 pose_matrix = pose_translation * pose_rotation * pose_scale;
-
-  // The calculated "pose_matrix" is actually the absolute position on the local
-  // space. I prefer to keep the "binding pose" of the skeleton, and reference
-  // key frames as a "delta" from these ones. If that pose_matrix is "identity"
-  // it means that the node hasn't been moved.
-
-  // Set the transform as a "delta" from the local transform
-  if (glm::mat4(1.f) == pose_matrix) {
-    pose_matrix = node.local_xform;
-  }
+/// A node that was never moved has a neutral pose, its local transform is
+/// used instead
+static bool is_neutral_pose(const glm::vec3& translation,
+                            const glm::quat& rotation, const glm::vec3& scale) {
+  return translation == glm::vec3(0.f) && scale == glm::vec3(1.f) &&
+         rotation.x == 0.f && rotation.y == 0.f && rotation.z == 0.f &&
+         (rotation.w == 1.f || rotation.w == -1.f);
+}
 
+void update_node_transform(gltf_node& node, const glm::mat4& parent_matrix) {
   /* This will accumulate the parent/child matrices to get everything in the
    * referential of `node`
    *
    * The node's "local" transform is the natural (binding) pose of the node
-   * relative to it's parent. The calculated "pose_matrix" is how much the
-   * node needs to be moved in space, relative to it's parent from this
-   * binding pose to be in the correct transform the animation wants it to
-   * be. The parent_matrix is the "world_transform" of the parent node,
-   * recursively passed down along the graph.
+   * relative to it's parent. The animated "pose" of a bone is the absolute
+   * transform relative to it's parent the animation wants it to be in, so it
+   * replaces the local transform. If the pose is neutral, the node hasn't
+   * been moved and keeps it's binding pose. The parent_matrix is the
+   * "world_transform" of the parent node, recursively passed down along the
+   * graph.
    *
    * The content of the node's "pose" structure used here will be updated by
    * the animation playing system in accordance to it's current clock,
    * interpolating between key frames (see class defined in animation.hh)
    */
+  const auto& pose = node.pose;
+  if (node.type != gltf_node::node_type::bone ||
+      is_neutral_pose(pose.translation, pose.rotation, pose.scale)) {
+    node.world_xform = parent_matrix * node.local_xform;
+    return;
+  }
 
-  node.world_xform = parent_matrix * node.local_xform *
-                     (node.type == gltf_node::node_type::bone
-                          ? glm::inverse(node.local_xform) * pose_matrix
-                          : glm::mat4(1.f));
+  node.world_xform =
+      parent_matrix * affine_to_mat4(affine_from_trs(
+                          pose.translation, pose.rotation, pose.scale));
+}
 
-  // node.world_xform = parent_matrix * node.local_xform;
+void update_mesh_skeleton_graph_transforms(gltf_node& node,
+                                           glm::mat4 parent_matrix) {
+  update_node_transform(node, parent_matrix);
 
   // recursively call itself until you reach a node with no children
   for (auto& child : node.children)
     update_mesh_skeleton_graph_transforms(*child, node.world_xform);
 }
 
+void flat_scene::build(gltf_node& root) {
+  clear();
+
+  // Depth first walk, with an explicit stack
+  std::vector<std::pair<gltf_node*, int>> stack(1, std::make_pair(&root, -1));
+  while (!stack.empty()) {
+    gltf_node* node = stack.back().first;
+    const int parent = stack.back().second;
+    stack.pop_back();
+
+    node->flat_index = int(nodes.size());
+    node->scene = this;
+    nodes.push_back(node);
+    parents.push_back(parent);
+
+    // Push them reversed so the first child is visited first
+    for (auto child = node->children.rbegin(); child != node->children.rend();
+         ++child)
+      stack.push_back(std::make_pair(child->get(), node->flat_index));
+  }
+
+  // In depth first order, the subtree of a node is the range of its size
+  // starting at that node. Children come after their parent so sizes can be
+  // accumulated backwards.
+  std::vector<int> subtree_sizes(nodes.size(), 1);
+  for (size_t i = nodes.size(); i-- > 1;)
+    subtree_sizes[size_t(parents[i])] += subtree_sizes[i];
+
+  subtree_ends.resize(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i)
+    subtree_ends[i] = int(i) + subtree_sizes[i];
+
+  const size_t count = nodes.size();
+  translations.resize(count);
+  scales.resize(count);
+  rotations.resize(count);
+  dirty.assign(count, true);
+  bones.resize(count);
+  local_xforms.resize(count);
+  world_xforms.resize(count);
+  changed.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    bones[i] = nodes[i]->type == gltf_node::node_type::bone;
+    local_xforms[i] = affine_from_mat4(nodes[i]->local_xform);
+    translations[i] = nodes[i]->pose.translation;
+    rotations[i] = nodes[i]->pose.rotation;
+    scales[i] = nodes[i]->pose.scale;
+  }
+}
+
+void flat_scene::clear() {
+  for (auto* node : nodes) {
+    node->flat_index = -1;
+    node->scene = nullptr;
+  }
+  nodes.clear();
+  parents.clear();
+  subtree_ends.clear();
+  translations.clear();
+  scales.clear();
+  rotations.clear();
+  dirty.clear();
+  bones.clear();
+  local_xforms.clear();
+  world_xforms.clear();
+  changed.clear();
+}
+
+size_t flat_scene::update(size_t begin, size_t end) {
+  // A node needs a new world transform if its pose changed, or if its parent
+  // got a new one. Parents come first, so one pass is enough.
+  size_t count = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const int parent = parents[i];
+    changed[i] = dirty[i] || (parent >= 0 && changed[size_t(parent)]);
+    // Bones are posed by animation, their local transform is only their rest
+    // pose. The local transform of other nodes can be edited, like the root
+    // by the mesh gizmo.
+    if (dirty[i] && !bones[i])
+      local_xforms[i] = affine_from_mat4(nodes[i]->local_xform);
+    dirty[i] = false;
+    count += changed[i];
+  }
+
+  if (count == 0) return 0;
+  propagate(begin, end);
+  scatter(begin, end);
+  return count;
+}
+
+void flat_scene::partition(
+    size_t chunk_size, std::vector<size_t>& serial,
+    std::vector<std::pair<size_t, size_t>>& chunks) const {
+  serial.clear();
+  chunks.clear();
+  if (nodes.empty()) return;
+  if (size() <= chunk_size) {
+    chunks.emplace_back(0, size());
+    return;
+  }
+
+  std::vector<size_t> to_split(1, 0);
+  while (!to_split.empty()) {
+    const size_t node = to_split.back();
+    to_split.pop_back();
+    serial.push_back(node);
+
+    // The subtrees of the children of a node are next to each other, small
+    // ones are grouped together and big ones are split again
+    const size_t node_end = size_t(subtree_ends[node]);
+    size_t group_begin = node + 1;
+    for (size_t child = node + 1; child < node_end;
+         child = size_t(subtree_ends[child])) {
+      const size_t child_end = size_t(subtree_ends[child]);
+      if (child_end - child > chunk_size) {
+        if (group_begin < child) chunks.emplace_back(group_begin, child);
+        group_begin = child_end;
+        to_split.push_back(child);
+      } else if (child_end - group_begin > chunk_size) {
+        chunks.emplace_back(group_begin, child);
+        group_begin = child;
+      }
+    }
+    if (group_begin < node_end) chunks.emplace_back(group_begin, node_end);
+  }
+
+  // Parents come before their children
+  std::sort(serial.begin(), serial.end());
+}
+
+void flat_scene::propagate(size_t begin, size_t end) {
+  // Same computation as update_node_transform(), see comments there
+  for (size_t i = begin; i < end; ++i) {
+    if (!changed[i]) continue;
+    const affine pose =
+        bones[i] && !is_neutral_pose(translations[i], rotations[i], scales[i])
+            ? affine_from_trs(translations[i], rotations[i], scales[i])
+            : local_xforms[i];
+
+    world_xforms[i] =
+        parents[i] < 0 ? pose : world_xforms[size_t(parents[i])] * pose;
+  }
+}
+
+void flat_scene::scatter(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i)
+    if (changed[i]) nodes[i]->world_xform = affine_to_mat4(world_xforms[i]);
+}
+
 glm::mat4 load_node_local_xform(const tinygltf::Node& node) {
   if (!node.name.empty()) std::cout << "name: " << node.name << "\n";
 
@@ -160,8 +344,9 @@ glm::mat4 load_node_local_xform(const tinygltf::Node& node) {
          glm::scale(glm::mat4(1.f), scale) * matrix;
 }
 
-void populate_gltf_graph(const tinygltf::Model& model, gltf_node& graph_root,
-                         int gltf_index) {
+static void populate_gltf_graph_recur(const tinygltf::Model& model,
+                                      gltf_node& graph_root, int gltf_index,
+                                      std::vector<gltf_node*>& index_table) {
   std::cout << "loading node " << gltf_index << "\n";
   // get the gltf node object
   const auto& root_node = model.nodes[size_t(gltf_index)];
@@ -170,16 +355,31 @@ void populate_gltf_graph(const tinygltf::Model& model, gltf_node& graph_root,
   graph_root.local_xform = xform;
   graph_root.gltf_node_index = gltf_index;
 
+  // keep the first node found, like a depth first search would
+  if (!index_table[size_t(gltf_index)])
+    index_table[size_t(gltf_index)] = &graph_root;
+
   for (int child : root_node.children) {
     // push a new children
     graph_root.add_child();
     // get the children object
     auto& new_node = *graph_root.children.back().get();
     // recurse
-    populate_gltf_graph(model, new_node, child);
+    populate_gltf_graph_recur(model, new_node, child, index_table);
   }
 }
 
+void populate_gltf_graph(const tinygltf::Model& model, gltf_node& graph_root,
+                         int gltf_index) {
+  // The lookup table lives in the root of the whole graph
+  gltf_node* root = &graph_root;
+  while (root->parent) root = root->parent;
+  root->node_index_table.resize(model.nodes.size(), nullptr);
+
+  populate_gltf_graph_recur(model, graph_root, gltf_index,
+                            root->node_index_table);
+}
+
 void set_mesh_attachment(const tinygltf::Model& model, gltf_node& graph_root) {
   if (graph_root.gltf_node_index != -1) {
     const auto& node = model.nodes[size_t(graph_root.gltf_node_index)];
@@ -226,7 +426,8 @@ void draw_bones(gltf_node& root, int active_joint_node_index, GLuint shader,
 
     const auto joint_inverse_bind_matrix =
         a_mesh.inverse_bind_matrices[joint_index];
-    const auto joint_matrix = a_mesh.joint_matrices[joint_index];
+    const auto joint_matrix =
+        affine_to_mat4(a_mesh.joint_matrices[joint_index]);
 
     const bool is_active =
         active_joint_node_index == joint_node->gltf_node_index;
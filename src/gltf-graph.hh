@@ -48,11 +48,15 @@ SOFTWARE.
 #endif
 
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include "affine.hh"
 #include "animation.hh"
 #include "configuration.hh"
 
+struct flat_scene;
+
 struct gltf_node {
   /// A node can be a mesh, or a bone, or can just be empty.
   ///
@@ -74,6 +78,11 @@ struct gltf_node {
   /// Pointer to the parent
   gltf_node* parent;
 
+  /// Position of this node in the flat_scene built from this graph, and that
+  /// scene. The pose setters write through to it.
+  int flat_index = -1;
+  flat_scene* scene = nullptr;
+
   /// Construct a node, give it it's node type, and a parent
   gltf_node(node_type t, gltf_node* p = nullptr);
 
@@ -88,6 +97,10 @@ struct gltf_node {
   /// Find node with set glTF index in children
   gltf_node* get_node_with_index(int index);
 
+  /// Only filled on the root of the graph by `populate_gltf_graph()`. Direct
+  /// access to any node from its glTF index.
+  std::vector<gltf_node*> node_index_table;
+
   /// Variables animated on this node.
   struct animation_state {
     glm::vec3 translation;
@@ -104,11 +117,77 @@ struct gltf_node {
           scale(glm::vec3(1.f, 1.f, 1.f)),
           rotation(1.f, 0.f, 0.f, 0.f) {}
   } pose;
+
+  /// Change the animated transform, and flag the node if it actually moved
+  void set_pose_translation(const glm::vec3& translation);
+  void set_pose_rotation(const glm::quat& rotation);
+  void set_pose_scale(const glm::vec3& scale);
+
+  /// Have the world transform of this node and its subtree recomputed by the
+  /// next update of its flat scene
+  void mark_transform_dirty();
 };
 
+/// Compute the world transform of this node only, from its pose and the world
+/// transform of its parent
+void update_node_transform(gltf_node& node, const glm::mat4& parent_matrix);
+
 void update_mesh_skeleton_graph_transforms(
     gltf_node& node, glm::mat4 parent_matrix = glm::mat4(1.f));
 
+/// Flat copy of the node graph used to compute the world transforms. The
+/// nodes are stored in depth first order : a parent always comes before its
+/// children, and the whole subtree of a node directly follows it. The pose
+/// setters of the nodes write into it, so an update only reads these arrays.
+/// The world transforms are scattered back to the nodes, which stay the
+/// reference for everything else.
+struct flat_scene {
+  std::vector<gltf_node*> nodes;
+  /// Index of the parent of each node, -1 for the root
+  std::vector<int> parents;
+  /// One past the index of the last node of the subtree of each node
+  std::vector<int> subtree_ends;
+
+  /// Animated pose of each node, read from the nodes by `build()` and kept up
+  /// to date by their pose setters
+  std::vector<glm::vec3> translations, scales;
+  std::vector<glm::quat> rotations;
+  /// Set for the nodes whose pose changed since their world transform was
+  /// last computed. The whole subtree below them will be recomputed.
+  std::vector<uint8_t> dirty;
+
+  /// Read by `build()`. The local transforms of the nodes that are not bones
+  /// are read again when they are dirty.
+  std::vector<uint8_t> bones;
+  std::vector<affine> local_xforms;
+
+  std::vector<affine> world_xforms;
+  /// Set for the nodes whose world transform was recomputed by the last
+  /// update
+  std::vector<uint8_t> changed;
+
+  /// Flatten the graph below `root`, and set the nodes flat_index
+  void build(gltf_node& root);
+  void clear();
+  size_t size() const { return nodes.size(); }
+
+  /// Update the world transforms of the nodes in [begin; end) that are dirty
+  /// or have a parent that was recomputed, and write them back to the nodes.
+  /// Parents of these nodes that are outside of the range need to be already
+  /// up to date. Return the number of recomputed nodes.
+  size_t update(size_t begin, size_t end);
+
+  /// Split the scene in ranges of at most `chunk_size` nodes that can be
+  /// updated independently, once the `serial` nodes above them have been
+  /// updated in order. Ranges are whole subtrees, or consecutive siblings.
+  void partition(size_t chunk_size, std::vector<size_t>& serial,
+                 std::vector<std::pair<size_t, size_t>>& chunks) const;
+
+ private:
+  void propagate(size_t begin, size_t end);
+  void scatter(size_t begin, size_t end);
+};
+
 void populate_gltf_graph(const tinygltf::Model& model, gltf_node& graph_root,
                          int gltf_index);
 
@@ -126,6 +205,7 @@ inline void empty_gltf_graph(gltf_node& graph_root) {
 
   graph_root.children.clear();  // shared pointers should go to 0 references,
                                 // only node that will survive is the root one
+  graph_root.node_index_table.clear();
 }
 
 // TODO use this snipet in a fragment shader to draw a cirle instead of a
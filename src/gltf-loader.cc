@@ -187,6 +187,7 @@ void load_animations(const tinygltf::Model& model,
     }
 
     animations[i].compute_time_boundaries();
+    animations[i].compute_cubic_coefficients();
   }
 }
 
@@ -201,6 +202,71 @@ glm::vec3 generate_flat_normal_for_triangle(std::vector<float>& position,
   return glm::normalize(glm::cross(v0 - v1, v1 - v2));
 }
 
+/// Read a JOINTS_n accessor into `joints`, 4 indices per vertex
+static void load_joints_accessor(const tinygltf::Model& model,
+                                 const tinygltf::Accessor& joints_accessor,
+                                 unsigned short* joints) {
+  const auto& joints_buffer_view =
+      model.bufferViews[joints_accessor.bufferView];
+  const auto& joints_buffer = model.buffers[joints_buffer_view.buffer];
+  const auto joints_stride = joints_accessor.ByteStride(joints_buffer_view);
+  const auto joints_start_pointer = joints_buffer.data.data() +
+                                    joints_buffer_view.byteOffset +
+                                    joints_accessor.byteOffset;
+  const size_t byte_size_of_component =
+      tinygltf::GetComponentSizeInBytes(joints_accessor.componentType);
+  assert(joints_accessor.type == TINYGLTF_TYPE_VEC4);
+  assert(sizeof(unsigned short) >= byte_size_of_component);
+
+  for (size_t i = 0; i < joints_accessor.count; ++i) {
+    // Indices can be unsigned bytes or unsigned shorts
+    for (size_t j = 0; j < 4; ++j) {
+      unsigned short temp = 0;
+      memcpy(&temp,
+             joints_start_pointer + i * joints_stride +
+                 j * byte_size_of_component,
+             byte_size_of_component);
+      joints[i * 4 + j] = temp;
+    }
+  }
+}
+
+/// Read a WEIGHTS_n accessor into `weights`, 4 weights per vertex
+static void load_weights_accessor(const tinygltf::Model& model,
+                                  const tinygltf::Accessor& weights_accessor,
+                                  float* weights) {
+  const auto& weights_buffer_view =
+      model.bufferViews[weights_accessor.bufferView];
+  const auto& weights_buffer = model.buffers[weights_buffer_view.buffer];
+  const auto weights_stride = weights_accessor.ByteStride(weights_buffer_view);
+  const auto weights_start_pointer = weights_buffer.data.data() +
+                                     weights_buffer_view.byteOffset +
+                                     weights_accessor.byteOffset;
+  const size_t byte_size_of_component =
+      tinygltf::GetComponentSizeInBytes(weights_accessor.componentType);
+  assert(weights_accessor.type == TINYGLTF_TYPE_VEC4);
+  assert(sizeof(float) >= byte_size_of_component);
+
+  for (size_t i = 0; i < weights_accessor.count; ++i) {
+    if (weights_accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      memcpy(&weights[i * 4], weights_start_pointer + i * weights_stride,
+             byte_size_of_component * 4);
+    } else {
+      // Must convert normalized unsigned value to floating point
+      unsigned short temp = 0;
+      for (size_t j = 0; j < 4; j++) {
+        memcpy(&temp,
+               weights_start_pointer + i * weights_stride +
+                   j * byte_size_of_component,
+               byte_size_of_component);
+        weights[i * 4 + j] =
+            float(temp) /
+            (byte_size_of_component == 2 ? float(0xFFFF) : float(0xFF));
+      }
+    }
+  }
+}
+
 void load_geometry(
     const tinygltf::Model& model, std::vector<GLuint>& textures,
     const std::vector<tinygltf::Primitive>& primitives,
@@ -212,7 +278,8 @@ void load_geometry(
     std::vector<std::vector<float>>& colors,
     std::vector<std::vector<float>>& normals,
     std::vector<std::vector<float>>& weights,
-    std::vector<std::vector<unsigned short>>& joints) {
+    std::vector<std::vector<unsigned short>>& joints,
+    std::vector<skin_influences>& influences) {
   std::cout << "loading mesh geometry...\n";
 
   const auto nb_submeshes = primitives.size();
@@ -408,74 +475,61 @@ void load_geometry(
       }
     }
 
+    // VERTEX JOINTS ASSIGNMENT AND BONE WEIGHTS
     bool has_joints = false;
-    // VERTEX JOINTS ASSIGNMENT
     if (primitive.attributes.find("JOINTS_0") !=
         std::end(primitive.attributes)) {
       has_joints = true;
-      const auto joint = primitive.attributes.at("JOINTS_0");
-      const auto& joints_accessor = model.accessors[joint];
-      const auto& joints_buffer_view =
-          model.bufferViews[joints_accessor.bufferView];
-      const auto& joints_buffer = model.buffers[joints_buffer_view.buffer];
-      const auto joints_stride = joints_accessor.ByteStride(joints_buffer_view);
-      const auto joints_start_pointer = joints_buffer.data.data() +
-                                        joints_buffer_view.byteOffset +
-                                        joints_accessor.byteOffset;
-      const size_t byte_size_of_component =
-          tinygltf::GetComponentSizeInBytes(joints_accessor.componentType);
-      assert(joints_accessor.type == TINYGLTF_TYPE_VEC4);
-      assert(sizeof(unsigned short) >= byte_size_of_component);
-
+      const auto& joints_accessor =
+          model.accessors[primitive.attributes.at("JOINTS_0")];
       joints[submesh].resize(4 * joints_accessor.count);
-
-      for (size_t i = 0; i < joints_accessor.count; ++i) {
-        memcpy(&joints[submesh][i * 4],
-               joints_start_pointer + i * joints_stride,
-               byte_size_of_component * 4);
-      }
+      load_joints_accessor(model, joints_accessor, joints[submesh].data());
     }
 
-    // VERTEX BONE WEIGHTS
     bool has_weights = false;
     if (primitive.attributes.find("WEIGHTS_0") !=
         std::end(primitive.attributes)) {
       has_weights = true;
-      const auto weight = primitive.attributes.at("WEIGHTS_0");
-      const auto& weights_accessor = model.accessors[weight];
-      const auto& weights_buffer_view =
-          model.bufferViews[weights_accessor.bufferView];
-      const auto& weights_buffer = model.buffers[weights_buffer_view.buffer];
-      const auto weights_stride =
-          weights_accessor.ByteStride(weights_buffer_view);
-      const auto weights_start_pointer = weights_buffer.data.data() +
-                                         weights_buffer_view.byteOffset +
-                                         weights_accessor.byteOffset;
-      const size_t byte_size_of_component =
-          tinygltf::GetComponentSizeInBytes(weights_accessor.componentType);
-      assert(weights_accessor.type == TINYGLTF_TYPE_VEC4);
-      assert(sizeof(float) >= byte_size_of_component);
-
+      const auto& weights_accessor =
+          model.accessors[primitive.attributes.at("WEIGHTS_0")];
       weights[submesh].resize(4 * weights_accessor.count);
+      load_weights_accessor(model, weights_accessor, weights[submesh].data());
+    }
 
-      for (size_t i = 0; i < weights_accessor.count; ++i) {
-        if (weights_accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
-          memcpy(&weights[submesh][i * 4],
-                 weights_start_pointer + i * weights_stride,
-                 byte_size_of_component * 4);
-        } else {
-          // Must convert normalized unsigned value to floating point
-          unsigned short temp = 0;
-          for (int j = 0; j < 4; j++) {
-            memcpy(&temp,
-                   weights_start_pointer + i * weights_stride +
-                       j * byte_size_of_component,
-                   byte_size_of_component);
-            weights[submesh][i * 4 + j] =
-                float(temp) /
-                (byte_size_of_component == 2 ? float(0xFFFF) : float(0xFF));
-          }
+    // The following sets only go to the sparse influences, the first one is
+    // also used as vertex attributes. The influences are bucketed by
+    // `build_skin_influences()` once the first set is known.
+    auto& submesh_influences = influences[submesh];
+    submesh_influences = skin_influences();
+    if (has_joints && has_weights) {
+      const size_t vertex_count = joints[submesh].size() / 4;
+      for (size_t set = 1;; ++set) {
+        const auto joints_it =
+            primitive.attributes.find("JOINTS_" + std::to_string(set));
+        const auto weights_it =
+            primitive.attributes.find("WEIGHTS_" + std::to_string(set));
+        if (joints_it == std::end(primitive.attributes) ||
+            weights_it == std::end(primitive.attributes))
+          break;
+
+        const auto& joints_accessor = model.accessors[joints_it->second];
+        const auto& weights_accessor = model.accessors[weights_it->second];
+        if (joints_accessor.count != vertex_count ||
+            weights_accessor.count != vertex_count) {
+          std::cerr << "Warn: ignoring JOINTS_" << set << " and WEIGHTS_" << set
+                    << ", they do not match the vertex count\n";
+          break;
         }
+
+        submesh_influences.extra_sets = set;
+        submesh_influences.extra_joints.resize(4 * set * vertex_count);
+        submesh_influences.extra_weights.resize(4 * set * vertex_count);
+        load_joints_accessor(
+            model, joints_accessor,
+            &submesh_influences.extra_joints[4 * (set - 1) * vertex_count]);
+        load_weights_accessor(
+            model, weights_accessor,
+            &submesh_influences.extra_weights[4 * (set - 1) * vertex_count]);
       }
     }
 
@@ -648,21 +702,25 @@ void load_morph_targets(const tinygltf::Model& model,
 
     if (position_it != target.end()) {
       const auto& position_accessor = model.accessors[position_it->second];
-      const auto& position_buffer_view =
-          model.bufferViews[position_accessor.bufferView];
-      const auto& position_buffer = model.buffers[position_buffer_view.buffer];
-      const auto position_data_start = position_buffer.data.data() +
-                                       position_buffer_view.byteOffset +
-                                       position_accessor.byteOffset;
-      const auto stride = position_accessor.ByteStride(position_buffer_view);
 
       assert(position_accessor.type == TINYGLTF_TYPE_VEC3);
       assert(position_accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-      morph_targets[i].position.resize(3 * position_accessor.count);
-      for (size_t vertex = 0; vertex < position_accessor.count; ++vertex) {
-        memcpy(&morph_targets[i].position[3 * vertex],
-               position_data_start + vertex * stride, sizeof(float) * 3);
+      // A sparse accessor without a buffer view starts out all zeros
+      morph_targets[i].position.assign(3 * position_accessor.count, 0.f);
+      if (position_accessor.bufferView >= 0) {
+        const auto& position_buffer_view =
+            model.bufferViews[size_t(position_accessor.bufferView)];
+        const auto& position_buffer =
+            model.buffers[size_t(position_buffer_view.buffer)];
+        const auto position_data_start = position_buffer.data.data() +
+                                         position_buffer_view.byteOffset +
+                                         position_accessor.byteOffset;
+        const auto stride = position_accessor.ByteStride(position_buffer_view);
+        for (size_t vertex = 0; vertex < position_accessor.count; ++vertex) {
+          memcpy(&morph_targets[i].position[3 * vertex],
+                 position_data_start + vertex * stride, sizeof(float) * 3);
+        }
       }
 
       if (position_accessor.sparse.isSparse) {
@@ -701,7 +759,7 @@ void load_morph_targets(const tinygltf::Model& model,
         // Patch the loaded sparse data into the morph target vertex attribute
         for (size_t sparse_index = 0; sparse_index < indices.size();
              ++sparse_index) {
-          memcpy(&morph_targets[i].position[indices[sparse_index]],
+          memcpy(&morph_targets[i].position[3 * size_t(indices[sparse_index])],
                  &values[sparse_index * 3], 3 * sizeof(float));
         }
       }
@@ -710,21 +768,25 @@ void load_morph_targets(const tinygltf::Model& model,
     if (normal_it != target.end()) {
       has_normal = true;
       const auto& normal_accessor = model.accessors[normal_it->second];
-      const auto& normal_buffer_view =
-          model.bufferViews[normal_accessor.bufferView];
-      const auto& normal_buffer = model.buffers[normal_buffer_view.buffer];
-      const auto normal_data_start = normal_buffer.data.data() +
-                                     normal_buffer_view.byteOffset +
-                                     normal_accessor.byteOffset;
-      const auto stride = normal_accessor.ByteStride(normal_buffer_view);
 
       assert(normal_accessor.type == TINYGLTF_TYPE_VEC3);
       assert(normal_accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-      morph_targets[i].normal.resize(3 * normal_accessor.count);
-      for (size_t vertex = 0; vertex < normal_accessor.count; ++vertex) {
-        memcpy(&morph_targets[i].normal[3 * vertex],
-               normal_data_start + vertex * stride, sizeof(float) * 3);
+      // A sparse accessor without a buffer view starts out all zeros
+      morph_targets[i].normal.assign(3 * normal_accessor.count, 0.f);
+      if (normal_accessor.bufferView >= 0) {
+        const auto& normal_buffer_view =
+            model.bufferViews[size_t(normal_accessor.bufferView)];
+        const auto& normal_buffer =
+            model.buffers[size_t(normal_buffer_view.buffer)];
+        const auto normal_data_start = normal_buffer.data.data() +
+                                       normal_buffer_view.byteOffset +
+                                       normal_accessor.byteOffset;
+        const auto stride = normal_accessor.ByteStride(normal_buffer_view);
+        for (size_t vertex = 0; vertex < normal_accessor.count; ++vertex) {
+          memcpy(&morph_targets[i].normal[3 * vertex],
+                 normal_data_start + vertex * stride, sizeof(float) * 3);
+        }
       }
 
       if (normal_accessor.sparse.isSparse) {
@@ -763,7 +825,7 @@ void load_morph_targets(const tinygltf::Model& model,
         // Patch the loaded sparse data into the morph target vertex attribute
         for (size_t sparse_index = 0; sparse_index < indices.size();
              ++sparse_index) {
-          memcpy(&morph_targets[i].normal[indices[sparse_index]],
+          memcpy(&morph_targets[i].normal[3 * size_t(indices[sparse_index])],
                  &values[sparse_index * 3], 3 * sizeof(float));
         }
       }
@@ -771,6 +833,70 @@ void load_morph_targets(const tinygltf::Model& model,
   }
 }
 
+void make_sparse_morph_target(morph_target& target, size_t vertex_count) {
+  // Dense deltas are indexed by vertex, missing ones don't move
+  target.position.resize(3 * vertex_count);
+  target.normal.resize(3 * vertex_count);
+  target.indices.clear();
+
+  const auto moves = [&target](size_t vertex) {
+    for (size_t i = 3 * vertex; i < 3 * vertex + 3; ++i)
+      if (target.position[i] != 0.f || target.normal[i] != 0.f) return true;
+    return false;
+  };
+  size_t moved = 0;
+  for (size_t vertex = 0; vertex < vertex_count; ++vertex)
+    if (moves(vertex)) ++moved;
+
+  // Empty indices mean dense deltas, so a target that moves nothing is marked
+  // instead. They are common in VRM models.
+  if (moved == 0) {
+    target.moves_vertices = false;
+    target.position.clear();
+    target.normal.clear();
+    target.position.shrink_to_fit();
+    target.normal.shrink_to_fit();
+    return;
+  }
+
+  // Dense deltas are read in order, and are smaller once most of the vertices
+  // move
+  if (2 * moved >= vertex_count) return;
+
+  target.indices.reserve(moved);
+  for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+    if (!moves(vertex)) continue;
+    const size_t delta = target.indices.size();
+    target.indices.push_back(unsigned(vertex));
+    for (size_t i = 0; i < 3; ++i) {
+      target.position[3 * delta + i] = target.position[3 * vertex + i];
+      target.normal[3 * delta + i] = target.normal[3 * vertex + i];
+    }
+  }
+  target.position.resize(3 * moved);
+  target.normal.resize(3 * moved);
+  target.position.shrink_to_fit();
+  target.normal.shrink_to_fit();
+}
+
+void pack_morph_target(morph_target& target, morph_delta_format format,
+                       morph_packing_stats& stats) {
+  stats.max_position_error =
+      std::max(stats.max_position_error,
+               target.packed_position.pack(target.position, format));
+  stats.max_normal_error =
+      std::max(stats.max_normal_error,
+               target.packed_normal.pack(target.normal, format));
+  stats.bytes += target.packed_position.bytes() + target.packed_normal.bytes();
+  stats.float_bytes +=
+      (target.position.size() + target.normal.size()) * sizeof(float);
+
+  target.position.clear();
+  target.position.shrink_to_fit();
+  target.normal.clear();
+  target.normal.shrink_to_fit();
+}
+
 void load_morph_target_names(const tinygltf::Mesh& mesh,
                              std::vector<std::string>& names) {
   if (mesh.extras.IsObject() && mesh.extras.Has("targetNames")) {
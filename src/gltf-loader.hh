@@ -28,6 +28,7 @@ SOFTWARE.
 
 #include "gl_util.hh"
 #include "gltf-graph.hh"
+#include "skinning.hh"
 
 struct morph_target {
   // std::string name;
@@ -35,7 +36,27 @@ struct morph_target {
   // doesn't define this.
   // See: https://github.com/KhronosGroup/glTF/issues/1036
 
+  /// Deltas of the vertices as loaded, xyz triplets, released once packed.
+  /// When `indices` is not empty, the target is sparse: only the vertices
+  /// listed in it move, and their deltas are stored in the same order.
   std::vector<float> position, normal;
+  std::vector<unsigned> indices;
+  /// False for a target that moves no vertex. It has no deltas at all, and is
+  /// never blended.
+  bool moves_vertices = true;
+
+  /// The deltas that are blended, filled from `position` and `normal` by
+  /// `pack_morph_target()`
+  morph_deltas packed_position, packed_normal;
+};
+
+/// Size and precision of the packed deltas of a set of morph targets
+struct morph_packing_stats {
+  size_t bytes = 0;
+  /// Size of the same deltas as floats
+  size_t float_bytes = 0;
+  float max_position_error = 0.f;
+  float max_normal_error = 0.f;
 };
 
 void load_animations(const tinygltf::Model& model,
@@ -52,13 +73,23 @@ void load_geometry(
     std::vector<std::vector<float>>& colors,
     std::vector<std::vector<float>>& normals,
     std::vector<std::vector<float>>& weights,
-    std::vector<std::vector<unsigned short>>& joints);
+    std::vector<std::vector<unsigned short>>& joints,
+    std::vector<skin_influences>& influences);
 
 void load_morph_targets(const tinygltf::Model& model,
                         const tinygltf::Primitive& primitive,
                         std::vector<morph_target>& morph_targets,
                         bool& has_normals, bool& has_tangents);
 
+/// Only keep the deltas of the vertices a dense target moves, if they are few
+/// enough. Missing positions or normals are filled with zeros.
+void make_sparse_morph_target(morph_target& target, size_t vertex_count);
+
+/// Store the deltas of a target in `format`, and release the float ones.
+/// Accumulate their size and error in `stats`.
+void pack_morph_target(morph_target& target, morph_delta_format format,
+                       morph_packing_stats& stats);
+
 void load_morph_target_names(const tinygltf::Mesh& mesh,
                              std::vector<std::string>& names);
 
@@ -786,6 +786,39 @@ void animation_window(std::vector<animation>& animations, bool* open) {
       ImGui::Text("Current Animation [%s]", selected_animation.name.c_str());
       ImGui::Text("Contains [%zu] channels",
                   selected_animation.channels.size());
+      const auto& folding = selected_animation.folding;
+      ImGui::Text("Folded [%d] static channels, removed [%zu] keys",
+                  folding.static_channels, folding.removed_keys);
+      ImGui::Text("[%d] channels inert at current time",
+                  selected_animation.inert_channels);
+      const auto& report = selected_animation.compression;
+      if (report.compressed) {
+        ImGui::Text("Compressed [%d] channels, [%d] left as is",
+                    report.compressed_channels, report.skipped_channels);
+        ImGui::Text("Keys [%zu] -> [%zu], bytes [%zu] -> [%zu] (%.1fx)",
+                    report.raw_keys, report.compressed_keys, report.raw_bytes,
+                    report.compressed_bytes,
+                    double(report.raw_bytes) /
+                        double(std::max<size_t>(report.compressed_bytes, 1)));
+        ImGui::Text("Max joint error [%f]", double(report.max_error));
+      }
+
+      if (selected_animation.baked_poses) {
+        const auto& cache = *selected_animation.baked_poses;
+        ImGui::Text("Pose cache [%d] frames, [%.1f] KiB%s, built in [%.1f] ms",
+                    cache.nb_frames, double(cache.byte_size()) / 1024.0,
+                    cache.quantized ? " (16 bit)" : "",
+                    cache.build_milliseconds);
+      }
+
+      // Compare the cost of the cubic spline evaluation from the keyframes
+      // and from the precomputed coefficients
+      static double hermite_ns = 0, horner_ns = 0;
+      if (ImGui::Button("Measure cubic spline evaluation"))
+        selected_animation.measure_cubic_evaluation(hermite_ns, horner_ns);
+      if (hermite_ns > 0)
+        ImGui::Text("Hermite [%.1f ns], Horner [%.1f ns] per evaluation",
+                    hermite_ns, horner_ns);
       ImGui::Separator();
 
       // Propose to change the channel we dsiplay why being sure we point to a
@@ -860,6 +893,21 @@ void animation_window(std::vector<animation>& animations, bool* open) {
         // error
       }
 
+      if (channel.is_static) {
+        ImGui::Text("Channel is static, its value is applied once");
+        ImGui::End();
+        return;
+      }
+
+      // The keyframes of a compressed channel have been released
+      if (!channel.compressed.empty()) {
+        ImGui::Text("Channel is compressed to [%zu] keys, [%zu] bytes",
+                    channel.compressed.times.size(),
+                    channel.compressed.byte_size());
+        ImGui::End();
+        return;
+      }
+
       ImGui::Separator();
       ImGui::Columns(column_count);
       ImGui::TextColored(ImVec4(1, .5, 0, 1), "TimePoint");
@@ -874,6 +922,7 @@ void animation_window(std::vector<animation>& animations, bool* open) {
           ImGui::NextColumn();
         }
 
+      bool edited = false;
       for (size_t frame = 0; frame < sampler.keyframes.size(); ++frame) {
         const std::string keyframe_input_name =
             "###"
@@ -881,8 +930,8 @@ void animation_window(std::vector<animation>& animations, bool* open) {
             std::to_string(frame);
 
         ImGui::PushItemWidth(-1);
-        ImGui::InputFloat(keyframe_input_name.c_str(),
-                          &sampler.keyframes[frame].second);
+        edited |= ImGui::InputFloat(keyframe_input_name.c_str(),
+                                    &sampler.keyframes[frame].second);
         ImGui::PopItemWidth();
         ImGui::NextColumn();
 
@@ -936,8 +985,9 @@ void animation_window(std::vector<animation>& animations, bool* open) {
 
               if (value_to_manipulate) {
                 ImGui::PushItemWidth(-1);
-                ImGui::InputFloat(keyframe_frame_comp_name.c_str(),
-                                  value_to_manipulate, 0, 0, "%.6f");
+                edited |=
+                    ImGui::InputFloat(keyframe_frame_comp_name.c_str(),
+                                      value_to_manipulate, 0, 0, "%.6f");
                 ImGui::PopItemWidth();
               }
             }
@@ -967,8 +1017,8 @@ void animation_window(std::vector<animation>& animations, bool* open) {
 
             if (value_to_manipulate) {
               ImGui::PushItemWidth(-1);
-              ImGui::InputFloat(keyframe_frame_comp_name.c_str(),
-                                value_to_manipulate, 0, 0, "%.6f");
+              edited |= ImGui::InputFloat(keyframe_frame_comp_name.c_str(),
+                                          value_to_manipulate, 0, 0, "%.6f");
               ImGui::PopItemWidth();
             }
           }
@@ -977,11 +1027,120 @@ void animation_window(std::vector<animation>& animations, bool* open) {
         }
         ImGui::Separator();
       }
+
+      if (edited) {
+        selected_animation.compute_cubic_coefficients();
+        selected_animation.revision++;
+      }
     }
   }
   ImGui::End();
 }
 
+void profiler_window(const std::vector<task_timing>& animation_tasks,
+                     const std::vector<task_timing>& geometry_tasks,
+                     unsigned nb_threads, const frame_statistics& statistics,
+                     bool* open) {
+  if (open && !*open) return;
+  if (ImGui::Begin("Profiler", open)) {
+    ImGui::Text("Running tasks on [%u] threads", nb_threads);
+    ImGui::Text("World transforms recomputed: [%zu/%zu] nodes",
+                statistics.recomputed_transforms, statistics.nb_nodes);
+    ImGui::Text("Software deformation: [%zu] submeshes evaluated, [%zu] "
+                "skipped",
+                statistics.deformable_submeshes - statistics.skipped_submeshes,
+                statistics.skipped_submeshes);
+    if (statistics.gpu_morphed_submeshes > 0)
+      ImGui::Text("GPU morphing: [%zu] submeshes",
+                  statistics.gpu_morphed_submeshes);
+    // Compare the skinning methods by switching between them
+    if (statistics.skinned_vertices > 0)
+      ImGui::Text("Software skinning (%s): [%zu] vertices in %.3f ms of work, "
+                  "%.1f Mvertices/s",
+                  statistics.skinning_method, statistics.skinned_vertices,
+                  statistics.skinning_time,
+                  double(statistics.skinned_vertices) /
+                      (1e3 * std::max(statistics.skinning_time, 1e-6)));
+    if (statistics.skinning_check.vertex_count > 0)
+      ImGui::Text("Skinning check: [%zu] vertices against the reference, "
+                  "position error %.1e, normal error %.1e, %s",
+                  statistics.skinning_check.vertex_count,
+                  double(statistics.skinning_check.position),
+                  double(statistics.skinning_check.normal),
+                  statistics.skinning_check.within_tolerance()
+                      ? "within tolerance"
+                      : "OUT OF TOLERANCE");
+    // Compare the fused and separate passes with the checkbox
+    if (statistics.deformation_bytes > 0)
+      ImGui::Text("CPU vertex deformation (%s): [%zu/%zu] morph targets "
+                  "active, %.3f ms of work, %.1f MB of vertex streams",
+                  statistics.deformation_pass, statistics.active_morph_targets,
+                  statistics.nb_morph_targets, statistics.deformation_time,
+                  double(statistics.deformation_bytes) / 1e6);
+    if (statistics.morph_delta_float_bytes > 0)
+      ImGui::Text("Morph deltas (%s): %.1f MB, %.1f MB as floats, largest "
+                  "error %.2e on positions, %.2e on normals",
+                  statistics.morph_delta_format,
+                  double(statistics.morph_delta_bytes) / 1e6,
+                  double(statistics.morph_delta_float_bytes) / 1e6,
+                  double(statistics.morph_delta_position_error),
+                  double(statistics.morph_delta_normal_error));
+
+    // CPU side only: the GL driver may defer the work of each call
+    if (statistics.scene_draw_calls > 0)
+      ImGui::Text("Scene draw: [%zu] draw calls, %.3f ms of CPU, %.2f us per "
+                  "draw call",
+                  statistics.scene_draw_calls, statistics.scene_draw_time,
+                  1e3 * statistics.scene_draw_time /
+                      double(statistics.scene_draw_calls));
+
+    const auto task_table = [nb_threads](
+                                const char* title,
+                                const std::vector<task_timing>& tasks) {
+      double wall_time = 0, cpu_time = 0;
+      for (const auto& task : tasks) {
+        wall_time = std::max(wall_time, task.start + task.duration);
+        cpu_time += task.duration;
+      }
+
+      if (!ImGui::CollapsingHeader(title, ImGuiTreeNodeFlags_DefaultOpen))
+        return;
+      ImGui::Text("[%zu] tasks, %.3f ms (%.3f ms of work)", tasks.size(),
+                  wall_time, cpu_time);
+      // How much of the threads were actually used
+      if (wall_time > 0)
+        ImGui::Text("Speedup %.2fx on [%u] threads", cpu_time / wall_time,
+                    nb_threads);
+
+      ImGui::Columns(4, title);
+      ImGui::TextColored(ImVec4(1, .5, 0, 1), "Task");
+      ImGui::NextColumn();
+      ImGui::TextColored(ImVec4(1, .5, 0, 1), "Thread");
+      ImGui::NextColumn();
+      ImGui::TextColored(ImVec4(1, .5, 0, 1), "Start (ms)");
+      ImGui::NextColumn();
+      ImGui::TextColored(ImVec4(1, .5, 0, 1), "Duration (ms)");
+      ImGui::NextColumn();
+      ImGui::Separator();
+      for (const auto& task : tasks) {
+        ImGui::Text("%s", task.name.c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%d", task.thread);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", task.start);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", task.duration);
+        ImGui::NextColumn();
+      }
+      ImGui::Columns(1);
+    };
+
+    task_table("Animation", animation_tasks);
+    task_table("Geometry", geometry_tasks);
+  }
+  ImGui::End();
+}
+
 void camera_parameters_window(float& fovy, float& z_far, bool* open) {
   if (open && !*open) return;
   if (ImGui::Begin("Camera Parameters", open)) {
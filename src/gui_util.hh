@@ -56,6 +56,8 @@ SOFTWARE.
 #include "animation.hh"
 #include "gltf-graph.hh"
 #include "material.hh"
+#include "skinning.hh"
+#include "task-scheduler.hh"
 #include "tiny_gltf.h"
 #include "tiny_gltf_util.h"
 
@@ -160,6 +162,46 @@ void animation_window(std::vector<animation>& animations, bool* open = nullptr);
 
 void camera_parameters_window(float& fovy, float& z_far, bool* open = nullptr);
 
+/// Counters about the work done during the last frame
+struct frame_statistics {
+  size_t recomputed_transforms = 0, nb_nodes = 0;
+  /// Submeshes that have software morphing or skinning, and the ones that
+  /// were left untouched because nothing they depend on changed
+  size_t deformable_submeshes = 0, skipped_submeshes = 0;
+  /// Submeshes morphed by the GPU pass instead of the CPU
+  size_t gpu_morphed_submeshes = 0;
+  /// Software skinning work of the last frame that skinned vertices
+  size_t skinned_vertices = 0;
+  double skinning_time = 0;
+  const char* skinning_method = "";
+  /// Last comparison of the software skinning to the reference
+  skinning_error skinning_check;
+  /// Morphing and skinning work of the last frame that morphed vertices, and
+  /// the size of the vertex streams it went through
+  double deformation_time = 0;
+  size_t deformation_bytes = 0;
+  const char* deformation_pass = "";
+  /// Morph targets blended by that frame, out of all the ones of the morphed
+  /// submeshes
+  size_t active_morph_targets = 0, nb_morph_targets = 0;
+  /// Storage of the morph target deltas of the loaded meshes, against the
+  /// same deltas as floats, and their largest errors
+  const char* morph_delta_format = "";
+  size_t morph_delta_bytes = 0, morph_delta_float_bytes = 0;
+  float morph_delta_position_error = 0, morph_delta_normal_error = 0;
+  /// Draw calls of the last scene draw, and the CPU time it took to set their
+  /// state and issue them
+  size_t scene_draw_calls = 0;
+  double scene_draw_time = 0;
+};
+
+/// Display the timing of the tasks run on the scheduler threads, and how much
+/// of the scene had to be updated
+void profiler_window(const std::vector<task_timing>& animation_tasks,
+                     const std::vector<task_timing>& geometry_tasks,
+                     unsigned nb_threads, const frame_statistics& statistics,
+                     bool* open = nullptr);
+
 GLuint load_gltf_insight_icon();
 void about_window(GLuint logo, bool* open = nullptr);
 
@@ -38,6 +38,7 @@ SOFTWARE.
 #endif
 
 // need matrix decomposition for 3D gizmo
+#include "animation-compression.hh"
 #include "animation.hh"
 #include "glm/gtx/matrix_decompose.hpp"
 
@@ -45,6 +46,8 @@ SOFTWARE.
 #pragma clang diagnostic pop
 #endif
 
+#include <chrono>
+#include <cstring>
 #include <tuple>
 using namespace gltf_insight;
 
@@ -71,6 +74,7 @@ void app::unload() {
   found_textured_shader = false;
 
   // loaded CPU side objects
+  pose_baker.cancel();
   animations.clear();
   animation_names.clear();
 
@@ -86,9 +90,14 @@ void app::unload() {
   input_filename.clear();
 
   // mesh data
+  flat_scene_graph.clear();
   empty_gltf_graph(gltf_scene_tree);
   loaded_meshes.clear();
   loaded_material.clear();
+  static_shaders.clear();
+  static_shader_uniforms.clear();
+  skinning_pass = shader();
+  morph_pass = shader();
 
   // library resources
   model = tinygltf::Model();
@@ -372,6 +381,9 @@ void app::load() {
     current_mesh.normals.resize(nb_submeshes);
     current_mesh.weights.resize(nb_submeshes);
     current_mesh.joints.resize(nb_submeshes);
+    current_mesh.influences.resize(nb_submeshes);
+    current_mesh.influence_offset_textures.resize(nb_submeshes, 0);
+    current_mesh.influence_textures.resize(nb_submeshes, 0);
     current_mesh.VAOs.resize(nb_submeshes);
     current_mesh.VBOs.resize(nb_submeshes);
     current_mesh.submesh_selection_ids.resize(nb_submeshes);
@@ -393,7 +405,9 @@ void app::load() {
                   current_mesh.VBOs, current_mesh.indices,
                   current_mesh.positions, current_mesh.uvs, current_mesh.colors,
                   current_mesh.normals, current_mesh.weights,
-                  current_mesh.joints);
+                  current_mesh.joints, current_mesh.influences);
+    for (size_t submesh = 0; submesh < nb_submeshes; ++submesh)
+      current_mesh.update_skin_influences(submesh);
 
     current_mesh.display_position = current_mesh.positions;
     current_mesh.display_normals = current_mesh.normals;
@@ -405,14 +419,8 @@ void app::load() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    current_mesh.shader_list = std::unique_ptr<std::map<std::string, shader>>(
-        new std::map<std::string, shader>);
-
-    current_mesh.soft_skin_shader_list =
-        std::unique_ptr<std::map<std::string, shader>>(
-            new std::map<std::string, shader>);
-
     current_mesh.morph_targets.resize(nb_submeshes);
+    current_mesh.morph_states.assign(nb_submeshes, submesh_morph_state());
     current_mesh.materials.resize(nb_submeshes);
     std::cerr << "loading primitive data:\n";
     for (size_t s = 0; s < nb_submeshes; ++s) {
@@ -486,6 +494,14 @@ void app::load() {
           }
         }
       }
+
+      // Facial targets usually move a small part of the mesh
+      for (auto& morph_target : current_mesh.morph_targets[s]) {
+        make_sparse_morph_target(morph_target,
+                                 current_mesh.positions[s].size() / 3);
+        pack_morph_target(morph_target, morph_deltas,
+                          current_mesh.morph_packing);
+      }
     }
 
     current_mesh.nb_morph_targets = 0;
@@ -498,9 +514,21 @@ void app::load() {
     load_morph_target_names(gltf_mesh, target_names);
     gltf_scene_tree.pose.target_names = target_names;
 
-    load_shaders(size_t(current_mesh.nb_joints), *current_mesh.shader_list);
-    if (current_mesh.skinned)
-      load_shaders(0, *current_mesh.soft_skin_shader_list);
+    const bool morphed = current_mesh.nb_morph_targets > 0;
+    if (current_mesh.skinned || morphed)
+      current_mesh.create_skinning_pass_buffers();
+    if (morphed) current_mesh.create_morph_delta_textures();
+
+    if (static_shaders.empty()) {
+      load_shaders(static_shaders);
+      load_draw_uniforms(static_shaders, static_shader_uniforms);
+    }
+    if (current_mesh.skinned && skinning_pass.get_program() == 0)
+      skinning_pass = load_skinning_pass_shader(skinning, morph_deltas);
+    if (!current_mesh.skinned && morphed && morph_pass.get_program() == 0)
+      morph_pass = load_morph_pass_shader(morph_deltas);
+    current_mesh.shader_list = &static_shaders;
+    current_mesh.uniform_list = &static_shader_uniforms;
   }
 
   const auto nb_animations = model.animations.size();
@@ -512,6 +540,15 @@ void app::load() {
     animation.set_gltf_graph_targets(&gltf_scene_tree);
   }
 
+  if (configuration::fold_animation_keys) fold_animations(animations);
+
+  if (configuration::compress_animations) {
+    animation_compression_settings settings;
+    settings.position_tolerance =
+        configuration::animation_compression_tolerance;
+    for (auto& animation : animations) compress_animation(animation, settings);
+  }
+
   // TODO this is ... mh... per node?
   auto nb_morph_targets = loaded_meshes[0].nb_morph_targets;
   for (size_t i = 1; i < loaded_meshes.size(); ++i) {
@@ -527,6 +564,8 @@ void app::load() {
   for (size_t i = 0; i < animations.size(); ++i)
     animation_names[i] = animations[i].name;
 
+  flat_scene_graph.build(gltf_scene_tree);
+
   asset_loaded = true;
 
   if (!loaded_meshes.empty()) {
@@ -546,6 +585,16 @@ void app::load() {
 mesh::~mesh() {
   for (auto& VBO : VBOs) glDeleteBuffers(VBO_count, VBO.data());
   glDeleteVertexArrays(GLsizei(VAOs.size()), VAOs.data());
+  glDeleteTextures(GLsizei(influence_offset_textures.size()),
+                   influence_offset_textures.data());
+  glDeleteTextures(GLsizei(influence_textures.size()),
+                   influence_textures.data());
+  glDeleteTextures(1, &joint_palette_texture);
+  glDeleteTextures(GLsizei(morph_delta_textures.size()),
+                   morph_delta_textures.data());
+  for (auto& VBO : skinning_pass_VBOs) glDeleteBuffers(2, VBO.data());
+  glDeleteVertexArrays(GLsizei(skinning_pass_VAOs.size()),
+                       skinning_pass_VAOs.data());
 
   displayed = true;
   skinned = false;
@@ -553,24 +602,280 @@ mesh::~mesh() {
 
   nb_joints = 0;
   nb_morph_targets = 0;
+  morph_packing = morph_packing_stats();
 
   joints.clear();
+  influences.clear();
+  influence_offset_textures.clear();
+  influence_textures.clear();
+  joint_palette_texture = 0;
+  morph_delta_textures.clear();
+  skinning_pass_VAOs.clear();
+  skinning_pass_VBOs.clear();
   positions.clear();
   uvs.clear();
   normals.clear();
   weights.clear();
   display_position.clear();
   display_normals.clear();
+  morph_states.clear();
   indices.clear();
   flat_joint_list.clear();
   joint_inverse_bind_matrix_map.clear();
   joint_matrices.clear();
+  skinning_palette.clear();
+  joint_dual_quaternions.clear();
+  previous_joint_matrices.clear();
+  soft_skinning_dirty = true;
+  joint_palette_dirty = true;
+  skinning_pass_dirty = true;
   colors.clear();
   instance.mesh = -1;
   instance.node = -1;
   draw_call_descriptors.clear();
 }
 
+void mesh::update_skin_influences(size_t submesh) {
+  auto& submesh_influences = influences[submesh];
+  if (!joints[submesh].empty() &&
+      joints[submesh].size() == weights[submesh].size())
+    build_skin_influences(joints[submesh], weights[submesh],
+                          submesh_influences);
+
+  // Up to 4 influences, the vertex attributes are enough
+  if (submesh_influences.max_influences <= 4) {
+    glDeleteTextures(1, &influence_offset_textures[submesh]);
+    glDeleteTextures(1, &influence_textures[submesh]);
+    influence_offset_textures[submesh] = influence_textures[submesh] = 0;
+    return;
+  }
+
+  std::vector<float> offsets, entries;
+  encode_skin_influences(submesh_influences, offsets, entries);
+  upload_data_texture(influence_offset_textures[submesh], offsets, 1);
+  upload_data_texture(influence_textures[submesh], entries, 2);
+}
+
+void mesh::bind_skin_influences(size_t submesh, const shader& program) const {
+  glActiveTexture(GLenum(GL_TEXTURE0 + texture_unit_joint_palette));
+  glBindTexture(GL_TEXTURE_2D, joint_palette_texture);
+
+  const bool sparse = influence_textures[submesh] != 0;
+  program.set_uniform("sparse_influences", int(sparse ? GL_TRUE : GL_FALSE));
+  if (!sparse) return;
+
+  glActiveTexture(GLenum(GL_TEXTURE0 + texture_unit_influence_offsets));
+  glBindTexture(GL_TEXTURE_2D, influence_offset_textures[submesh]);
+  glActiveTexture(GLenum(GL_TEXTURE0 + texture_unit_influences));
+  glBindTexture(GL_TEXTURE_2D, influence_textures[submesh]);
+}
+
+void mesh::upload_joint_palette(skinning_method method) {
+  // Both palettes are arrays of vec4, 3 per joint matrix and 2 per dual
+  // quaternion
+  if (method == skinning_method::dual_quaternion)
+    upload_data_texture(
+        joint_palette_texture,
+        reinterpret_cast<const float*>(joint_dual_quaternions.data()),
+        8 * joint_dual_quaternions.size(), 4);
+  else
+    upload_data_texture(joint_palette_texture,
+                        reinterpret_cast<const float*>(joint_matrices.data()),
+                        12 * joint_matrices.size(), 4);
+  joint_palette_dirty = false;
+  skinning_pass_dirty = true;
+}
+
+void mesh::create_skinning_pass_buffers() {
+  const size_t nb_submeshes = VAOs.size();
+  skinning_pass_VAOs.resize(nb_submeshes);
+  skinning_pass_VBOs.resize(nb_submeshes);
+  glGenVertexArrays(GLsizei(nb_submeshes), skinning_pass_VAOs.data());
+  for (size_t submesh = 0; submesh < nb_submeshes; ++submesh) {
+    auto& VBO = skinning_pass_VBOs[submesh];
+    glGenBuffers(2, VBO.data());
+    upload_skinning_pass_input(submesh);
+
+    glBindVertexArray(skinning_pass_VAOs[submesh]);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
+    glVertexAttribPointer(VBO_layout_position, 3, GL_FLOAT, GL_FALSE,
+                          3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(VBO_layout_position);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
+    glVertexAttribPointer(VBO_layout_normal, 3, GL_FLOAT, GL_FALSE,
+                          3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(VBO_layout_normal);
+    if (!skinned) continue;
+
+    // Same joints and weights as the draws, see `load_geometry()`
+    glBindBuffer(GL_ARRAY_BUFFER, VBOs[submesh][VBO_layout_joints]);
+    glVertexAttribPointer(VBO_layout_joints, 4, GL_UNSIGNED_SHORT, GL_FALSE,
+                          4 * sizeof(unsigned short), nullptr);
+    glEnableVertexAttribArray(VBO_layout_joints);
+    glBindBuffer(GL_ARRAY_BUFFER, VBOs[submesh][VBO_layout_weights]);
+    glVertexAttribPointer(VBO_layout_weights, 4, GL_FLOAT, GL_FALSE,
+                          4 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(VBO_layout_weights);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// Lay out the packed deltas of the targets of a submesh for its delta
+/// texture, as values of type `T`. Two texels per target and vertex, the
+/// position then the normal delta. The vertices a sparse target doesn't move
+/// get zeros.
+template <typename T>
+static std::vector<T> scatter_morph_deltas(
+    const std::vector<morph_target>& targets, size_t vertex_count) {
+  std::vector<T> deltas(6 * targets.size() * vertex_count, T(0));
+  for (size_t t = 0; t < targets.size(); ++t) {
+    const auto& target = targets[t];
+    const auto position = static_cast<const T*>(target.packed_position.data());
+    const auto normal = static_cast<const T*>(target.packed_normal.data());
+    T* target_deltas = deltas.data() + 6 * t * vertex_count;
+    for (size_t delta = 0; delta < target.packed_position.size() / 3;
+         ++delta) {
+      const size_t vertex =
+          target.indices.empty() ? delta : target.indices[delta];
+      std::copy_n(position + 3 * delta, 3, target_deltas + 6 * vertex);
+      std::copy_n(normal + 3 * delta, 3, target_deltas + 6 * vertex + 3);
+    }
+  }
+  return deltas;
+}
+
+void mesh::create_morph_delta_textures() {
+  GLint max_texture_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+  morph_delta_textures.assign(morph_targets.size(), 0);
+  for (size_t submesh = 0; submesh < morph_targets.size(); ++submesh) {
+    const auto& targets = morph_targets[submesh];
+    const size_t vertex_count = positions[submesh].size() / 3;
+    if (targets.empty() || vertex_count == 0) continue;
+
+    // Two texels per target and vertex, the position then the normal delta.
+    // The shader indexes them with an int.
+    const size_t texels = 2 * targets.size() * vertex_count;
+    const size_t rows = (texels + size_t(data_texture_width) - 1) /
+                        size_t(data_texture_width);
+    if (texels > size_t(std::numeric_limits<int>::max()) ||
+        rows > size_t(max_texture_size))
+      continue;
+
+    // The texture keeps the format of the deltas. The pass gets the scale of
+    // the int16 ones with the weights.
+    const auto format = targets.front().packed_position.format;
+    if (format == morph_delta_format::float32)
+      upload_data_texture(morph_delta_textures[submesh],
+                          scatter_morph_deltas<float>(targets, vertex_count),
+                          3);
+    else
+      upload_data_texture(
+          morph_delta_textures[submesh],
+          scatter_morph_deltas<uint16_t>(targets, vertex_count), 3,
+          format == morph_delta_format::int16);
+  }
+}
+
+void mesh::upload_skinning_pass_input(size_t submesh) {
+  const bool gpu_morphed = morph_states[submesh].gpu_morphed;
+  const auto& pass_positions =
+      gpu_morphed ? positions[submesh] : display_position[submesh];
+  const auto& pass_normals =
+      gpu_morphed ? normals[submesh] : display_normals[submesh];
+  const auto& VBO = skinning_pass_VBOs[submesh];
+  glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
+  glBufferData(GL_ARRAY_BUFFER,
+               GLsizeiptr(pass_positions.size() * sizeof(float)),
+               pass_positions.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(pass_normals.size() * sizeof(float)),
+               pass_normals.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void mesh::bind_morph_targets(size_t submesh, const shader& program,
+                              const std::vector<float>& morph_weights) const {
+  std::vector<int> targets;
+  std::vector<float> weights, normal_weights;
+  if (morph_states[submesh].gpu_morphed)
+    for (size_t t = 0;
+         t < std::min(morph_weights.size(), morph_targets[submesh].size()) &&
+         targets.size() < size_t(max_gpu_morph_targets);
+         ++t) {
+      if (morph_weights[t] == 0.f) continue;
+      const auto& target = morph_targets[submesh][t];
+      targets.push_back(int(t));
+      weights.push_back(morph_weights[t] * target.packed_position.scale);
+      normal_weights.push_back(morph_weights[t] * target.packed_normal.scale);
+    }
+
+  program.set_uniform("morph_target_count", int(targets.size()));
+  if (targets.empty()) return;
+
+  glActiveTexture(GLenum(GL_TEXTURE0 + texture_unit_morph_deltas));
+  glBindTexture(GL_TEXTURE_2D, morph_delta_textures[submesh]);
+  program.set_uniform("morph_vertex_count",
+                      int(positions[submesh].size() / 3));
+  program.set_uniform("morph_targets", targets);
+  program.set_uniform("morph_weights", weights);
+  program.set_uniform("morph_normal_weights", normal_weights);
+}
+
+void mesh::run_skinning_pass(size_t submesh, const shader& pass,
+                             const std::vector<float>& morph_weights) const {
+  const size_t vertex_count = display_position[submesh].size() / 3;
+  if (vertex_count == 0) return;
+
+  pass.use();
+  if (skinned) bind_skin_influences(submesh, pass);
+  bind_morph_targets(submesh, pass, morph_weights);
+
+  // The output buffers need to have their size before being bound
+  const GLsizeiptr size = GLsizeiptr(3 * vertex_count * sizeof(float));
+  const GLuint outputs[] = {VBOs[submesh][VBO_layout_position],
+                            VBOs[submesh][VBO_layout_normal]};
+  for (GLuint index = 0; index < 2; ++index) {
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, outputs[index]);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, index, outputs[index]);
+  }
+
+  // One point per vertex, so each vertex is skinned exactly once
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindVertexArray(skinning_pass_VAOs[submesh]);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, GLsizei(vertex_count));
+  glEndTransformFeedback();
+  glBindVertexArray(0);
+  glDisable(GL_RASTERIZER_DISCARD);
+
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, 0);
+  glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+}
+
+void mesh::read_back_deformed_vertices(size_t submesh) {
+  const auto read_back = [](GLuint buffer, std::vector<float>& data) {
+    const GLsizeiptr size = GLsizeiptr(data.size() * sizeof(float));
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    const void* mapped =
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped) {
+      memcpy(data.data(), mapped, size_t(size));
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+  };
+
+  read_back(
+      VBOs[submesh][VBO_layout_position],
+      skinned ? soft_skinned_position[submesh] : display_position[submesh]);
+  read_back(VBOs[submesh][VBO_layout_normal],
+            skinned ? soft_skinned_normals[submesh] : display_normals[submesh]);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 bool mesh::raycast_submesh_camera_mouse(glm::mat4 world_xform, size_t submesh,
                                         glm::vec3 world_camera_position,
                                         glm::mat4 vp, float x, float y) const {
@@ -740,10 +1045,18 @@ mesh& mesh::operator=(mesh&& o) {
   instance = o.instance;
   displayed = o.displayed;
   joint_matrices = std::move(o.joint_matrices);
+  skinning_palette = std::move(o.skinning_palette);
+  joint_dual_quaternions = std::move(o.joint_dual_quaternions);
+  previous_joint_matrices = std::move(o.previous_joint_matrices);
+  soft_skinning_dirty = o.soft_skinning_dirty;
+  joint_palette_dirty = o.joint_palette_dirty;
+  skinning_pass_dirty = o.skinning_pass_dirty;
   joint_inverse_bind_matrix_map = std::move(o.joint_inverse_bind_matrix_map);
   flat_joint_list = std::move(o.flat_joint_list);
   inverse_bind_matrices = std::move(o.inverse_bind_matrices);
   morph_targets = std::move(o.morph_targets);
+  morph_packing = o.morph_packing;
+  morph_states = std::move(o.morph_states);
   draw_call_descriptors = std::move(o.draw_call_descriptors);
   indices = std::move(o.indices);
   positions = std::move(o.positions);
@@ -755,10 +1068,23 @@ mesh& mesh::operator=(mesh&& o) {
   soft_skinned_position = std::move(o.soft_skinned_position);
   soft_skinned_normals = std::move(o.soft_skinned_normals);
   joints = std::move(o.joints);
+  influences = std::move(o.influences);
+  influence_offset_textures = std::move(o.influence_offset_textures);
+  influence_textures = std::move(o.influence_textures);
+  o.influence_offset_textures.clear();
+  o.influence_textures.clear();
+  joint_palette_texture = o.joint_palette_texture;
+  o.joint_palette_texture = 0;
+  morph_delta_textures = std::move(o.morph_delta_textures);
+  o.morph_delta_textures.clear();
+  skinning_pass_VAOs = std::move(o.skinning_pass_VAOs);
+  skinning_pass_VBOs = std::move(o.skinning_pass_VBOs);
+  o.skinning_pass_VAOs.clear();
+  o.skinning_pass_VBOs.clear();
   colors = std::move(o.colors);
 
-  shader_list = std::move(o.shader_list);
-  soft_skin_shader_list = std::move(o.soft_skin_shader_list);
+  shader_list = o.shader_list;
+  uniform_list = o.uniform_list;
 
   return *this;
 }
@@ -834,20 +1160,35 @@ void app::async_worker::work_for_one_frame() {
     anim.set_time(current_animation_time);
     anim.apply_pose();
   }
-  update_mesh_skeleton_graph_transforms(the_app->gltf_scene_tree);
+  the_app->flat_scene_graph.update(0, the_app->flat_scene_graph.size());
   for (auto& mesh : the_app->loaded_meshes) {
     the_app->compute_joint_matrices(the_app->root_node_model_matrix,
                                     mesh.joint_matrices, mesh.flat_joint_list,
                                     mesh.inverse_bind_matrices);
+    // With GPU skinning, the skinning pass runs on the exported pose and its
+    // results are read back
+    const bool gpu_skinning = mesh.skinned && !the_app->do_soft_skinning;
+    if (the_app->skinning == skinning_method::dual_quaternion)
+      build_dual_quaternion_palette(mesh.joint_matrices,
+                                    mesh.joint_dual_quaternions);
+    else if (!gpu_skinning)
+      build_skinning_palette(mesh.joint_matrices, mesh.skinning_palette);
+    if (gpu_skinning) mesh.upload_joint_palette(the_app->skinning);
     for (size_t sm = 0; sm < mesh.indices.size(); ++sm) {
+      // Only the display vertices are brought up to date, the drawn ones
+      // are evaluated again by the next frame
       the_app->perform_software_morphing(
-          the_app->gltf_scene_tree, sm, mesh.morph_targets, mesh.positions,
-          mesh.normals, mesh.display_position, mesh.display_normals, mesh.VBOs,
-          false);
-      the_app->perform_software_skinning(
-          sm, mesh.joint_matrices, mesh.display_position, mesh.display_normals,
-          mesh.joints, mesh.weights, mesh.soft_skinned_position,
-          mesh.soft_skinned_normals);
+          the_app->gltf_scene_tree, sm, mesh.morph_states[sm],
+          mesh.morph_targets, mesh.positions, mesh.normals,
+          mesh.display_position, mesh.display_normals, mesh.VBOs, false);
+      if (gpu_skinning) {
+        mesh.upload_skinning_pass_input(sm);
+        mesh.run_skinning_pass(sm, the_app->skinning_pass,
+                               the_app->gltf_scene_tree.pose.blend_weights);
+        mesh.read_back_deformed_vertices(sm);
+      } else {
+        the_app->perform_software_skinning(mesh, sm);
+      }
     }
   }
 
@@ -1047,6 +1388,7 @@ void app::run_view_menu() {
     ImGui::MenuItem("Bone display window", nullptr, &show_bone_display_window);
     ImGui::MenuItem("Scene outline", nullptr, &show_scene_outline_window);
     ImGui::MenuItem("OBJ export window", nullptr, &show_obj_export_window);
+    ImGui::MenuItem("Profiler", nullptr, &show_profiler_window);
     ImGui::Separator();
     ImGui::MenuItem("Show Gizmo", nullptr, &show_gizmo);
     ImGui::MenuItem("Editor light controls", nullptr,
@@ -1227,21 +1569,21 @@ void app::draw_mesh(const glm::vec3& world_camera_location, const mesh& mesh,
 
         material_to_use.bind_textures();
 
-        auto& active_shader_list = (mesh.skinned && do_soft_skinning)
-                                       ? *mesh.soft_skin_shader_list
-                                       : *mesh.shader_list;
+        // Skinned vertices are already in the vertex buffers, whether they
+        // were skinned on the CPU or by the GPU skinning pass
+        const auto& active_shader = (*mesh.shader_list)[shader_to_use];
+        const auto& uniforms = (*mesh.uniform_list)[shader_to_use];
 
-        const auto& active_shader = active_shader_list[shader_to_use];
-
-        material_to_use.set_shader_uniform(active_shader);
+        material_to_use.set_shader_uniform(active_shader, uniforms.material);
 
         update_uniforms(
-            active_shader_list, editor_light.use_ibl, world_camera_location,
-            editor_light.color, editor_light.get_directional_light_direction(),
-            active_joint_index_model, shader_to_use,
+            active_shader, uniforms, editor_light.use_ibl,
+            world_camera_location, editor_light.color,
+            editor_light.get_directional_light_direction(),
+            active_joint_index_model,
             projection_matrix * view_matrix * model_matrix,
             projection_matrix * view_matrix * model_matrix, normal_matrix,
-            mesh.joint_matrices, active_poly_indices);
+            active_poly_indices);
 
         double_sided = material_to_use.double_sided;
 
@@ -1270,6 +1612,7 @@ void app::draw_mesh(const glm::vec3& world_camera_location, const mesh& mesh,
     }
 
     perform_draw_call(draw_call);
+    scene_draw_calls++;
   }
 }
 
@@ -1304,6 +1647,8 @@ void app::draw_scene_recur(const glm::vec3& world_camera_location,
 }
 
 void app::draw_scene(const glm::vec3& world_camera_location) {
+  const auto start = std::chrono::steady_clock::now();
+  scene_draw_calls = 0;
   std::vector<defered_draw> alpha;
   draw_scene_recur(world_camera_location, gltf_scene_tree, alpha);
 
@@ -1332,6 +1677,13 @@ void app::draw_scene(const glm::vec3& world_camera_location) {
       }
     }
   }
+
+  frame_stats.scene_draw_calls = scene_draw_calls;
+  frame_stats.scene_draw_time =
+      double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - start)
+                 .count()) /
+      1e6;
 }
 
 void app::draw_color_select_map_recur(gltf_node& node) {
@@ -1340,22 +1692,24 @@ void app::draw_color_select_map_recur(gltf_node& node) {
   if (node.type == gltf_node::node_type::mesh) {
     auto& mesh = loaded_meshes[size_t(node.gltf_mesh_id)];
 
+    const auto& color_shader = (*mesh.shader_list)["debug_color"];
+    const auto& uniforms = (*mesh.uniform_list)["debug_color"];
+
     for (size_t i = 0; i < mesh.draw_call_descriptors.size(); ++i) {
       const glm::vec4 id_color = mesh.submesh_selection_ids[i];
 
-      update_uniforms(*mesh.shader_list, editor_light.use_ibl,
+      update_uniforms(color_shader, uniforms, editor_light.use_ibl,
                       glm::vec3(0, 0, 0), editor_light.color,
                       editor_light.get_directional_light_direction(),
-                      active_joint_index_model, "debug_color",
+                      active_joint_index_model,
                       projection_matrix * view_matrix * node.world_xform,
                       projection_matrix * view_matrix * node.world_xform,
                       glm::inverse(glm::transpose(node.world_xform)),
-                      mesh.joint_matrices, active_poly_indices);
+                      active_poly_indices);
 
-      const auto& color_shader = (*mesh.shader_list)["debug_color"];
-      color_shader.use();
       color_shader.set_uniform(
-          "debug_color", glm::vec4(id_color.r, id_color.g, id_color.b, 1));
+          uniforms.debug_color,
+          glm::vec4(id_color.r, id_color.g, id_color.b, 1));
 
       perform_draw_call(mesh.draw_call_descriptors[i]);
     }
@@ -1456,7 +1810,10 @@ void app::get_submesh_below_mouse_cursor(bool& clicked_on_submesh,
 
 void app::get_vertex_below_mouse_cursor(size_t mesh_id, size_t submesh_id) {
   // std::cout << "clicked on " << mesh_id << ":" << submesh_id << "\n";
-  const auto& mesh = loaded_meshes[mesh_id];
+  auto& mesh = loaded_meshes[mesh_id];
+  if ((mesh.skinned && !do_soft_skinning) ||
+      mesh.morph_states[submesh_id].gpu_morphed)
+    mesh.read_back_deformed_vertices(submesh_id);
 
   auto node = gltf_scene_tree.get_node_with_index(mesh.instance.node);
   if (node) {
@@ -1623,6 +1980,9 @@ void app::handle_current_selection() {
       if (changed) {
         gpu_update_submesh_skinning_data(size_t(active_submesh_index),
                                          mesh.weights, mesh.joints, mesh.VBOs);
+        mesh.update_skin_influences(size_t(active_submesh_index));
+        mesh.soft_skinning_dirty = true;
+        mesh.skinning_pass_dirty = true;
       }
     }
   }
@@ -1686,7 +2046,8 @@ void app::update_rendering_matrices() {
           ? loaded_meshes[0].flat_joint_list[size_t(active_joint_index_model)]
           : nullptr);
 
-  update_mesh_skeleton_graph_transforms(gltf_scene_tree);
+  // The world transforms of the scene are updated by the tasks run in
+  // update_geometry()
 
   const glm::quat camera_rotation(
       glm::vec3(glm::radians(gui_parameters.rot_pitch),
@@ -1698,35 +2059,163 @@ void app::update_rendering_matrices() {
                             camera_rotation * glm::vec3(0, 1.f, 0));
 }
 
-void app::perform_skinning_and_morphing(bool gpu_geometry_buffers_dirty,
-                                        std::vector<mesh>::value_type& a_mesh) {
-  for (size_t submesh = 0; submesh < a_mesh.draw_call_descriptors.size();
-       ++submesh) {
-    if (gltf_scene_tree.pose.blend_weights.size() > 0)
-      perform_software_morphing(
-          gltf_scene_tree, submesh, a_mesh.morph_targets, a_mesh.positions,
-          a_mesh.normals, a_mesh.display_position, a_mesh.display_normals,
-          a_mesh.VBOs, a_mesh.skinned ? !do_soft_skinning : true);
-
-    // do not upload to GPU if soft skin is on
-
-    if (a_mesh.skinned) {
-      if (do_soft_skinning) {
-        perform_software_skinning(
-            submesh, a_mesh.joint_matrices, a_mesh.display_position,
-            a_mesh.display_normals, a_mesh.joints, a_mesh.weights,
-            a_mesh.soft_skinned_position, a_mesh.soft_skinned_normals);
-        // now, upload new mesh to GPU
-        gpu_update_submesh_buffers(submesh, a_mesh.soft_skinned_position,
-                                   a_mesh.soft_skinned_normals, a_mesh.VBOs);
-      } else if (gpu_geometry_buffers_dirty) {
-        gpu_update_submesh_buffers(submesh, a_mesh.display_position,
-                                   a_mesh.display_normals, a_mesh.VBOs);
-      }
+app::submesh_deformation app::plan_submesh_deformation(
+    bool gpu_geometry_buffers_dirty, mesh& a_mesh, size_t submesh) {
+  submesh_deformation deformation;
+  const auto& blend_weights = gltf_scene_tree.pose.blend_weights;
+  const auto& targets = a_mesh.morph_targets[submesh];
+  const bool morphed = blend_weights.size() > 0 && targets.size() > 0;
+
+  if (a_mesh.skinned && do_soft_skinning) {
+    deformation.deformable = true;
+    deformation.skin = true;
+    deformation.upload = submesh_upload::soft_skinned;
+  }
+
+  if (morphed) {
+    deformation.deformable = true;
+    auto& state = a_mesh.morph_states[submesh];
+    state.update(blend_weights);
+
+    // The GPU pass morphs the vertices when nothing needs them on the CPU. It
+    // starts from the base vertices, that are only sent once.
+    size_t active_targets = 0;
+    for (size_t t = 0; t < std::min(blend_weights.size(), targets.size()); ++t)
+      if (blend_weights[t] != 0.f) ++active_targets;
+    if (do_gpu_morphing && !deformation.skin &&
+        a_mesh.morph_delta_textures[submesh] != 0 &&
+        active_targets <= size_t(max_gpu_morph_targets)) {
+      deformation.gpu_morph = state.drawn_dirty() || !state.gpu_morphed;
+      deformation.upload = state.gpu_morphed
+                               ? submesh_upload::none
+                               : submesh_upload::skinning_pass_input;
+      state.gpu_morphed = true;
+      state.drawn_generation = state.generation;
+      return deformation;
     }
+    // The vertex buffers still hold the output of the GPU pass
+    if (state.gpu_morphed) state.drawn_generation = 0;
+    state.gpu_morphed = false;
+
+    // The fused pass never writes the display vertices. When they are needed
+    // again, they are morphed even if the weights did not change.
+    deformation.morph = state.drawn_dirty();
+    deformation.fused = deformation.skin && fused_deformation &&
+                        (deformation.morph || state.display_dirty());
+    if (!deformation.fused && state.display_dirty()) deformation.morph = true;
+    state.drawn_generation = state.generation;
+    if (!deformation.fused) state.display_generation = state.generation;
+
+    if (deformation.morph || deformation.fused)
+      gather_active_morph_targets(gltf_scene_tree, targets,
+                                  a_mesh.positions[submesh].size() / 3,
+                                  deformation.blend);
+  }
+
+  // do not upload to GPU if soft skin is on
+  if (!deformation.skin &&
+      (deformation.morph || (a_mesh.skinned && gpu_geometry_buffers_dirty)))
+    deformation.upload = a_mesh.skinned ? submesh_upload::skinning_pass_input
+                                        : submesh_upload::display;
+
+  return deformation;
+}
+
+void app::deform_submesh_vertices(mesh& a_mesh, size_t submesh,
+                                  const submesh_deformation& deformation,
+                                  size_t begin, size_t end) {
+  const bool skin =
+      deformation.skin && (deformation.morph || a_mesh.soft_skinning_dirty);
+  const bool fused = deformation.fused && skin;
+  const auto start = std::chrono::steady_clock::now();
+  if (deformation.morph && !fused)
+    software_morph_vertices(deformation.blend, submesh, a_mesh.positions,
+                            a_mesh.normals, a_mesh.display_position,
+                            a_mesh.display_normals, begin, end);
+
+  const auto skinning_start = std::chrono::steady_clock::now();
+  if (skin) {
+    perform_software_skinning(a_mesh, submesh, begin, end,
+                              fused ? &deformation.blend : nullptr);
+    skinning_nanoseconds +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - skinning_start)
+            .count();
+    const size_t vertex_count = a_mesh.influences[submesh].vertex_count;
+    if (begin < vertex_count)
+      skinned_vertices += std::min(end, vertex_count) - begin;
+  }
+
+  if (!deformation.morph && !fused) return;
+  deformation_nanoseconds +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  // Each vertex stream is a position and a normal. Morphing reads the base
+  // vertex and the deltas of the active targets, and writes the display vertex
+  // that skinning reads back. The fused pass skips the display vertex.
+  const size_t stream = (end - begin) * 6 * sizeof(float);
+  deformation_bytes += deformation.blend.delta_bytes(begin, end) +
+                       stream * (skin && !fused ? 4 : 2);
+}
+
+void app::upload_deformed_submesh(mesh& a_mesh, size_t submesh,
+                                  submesh_upload upload) {
+  switch (upload) {
+    case submesh_upload::display:
+      gpu_update_submesh_buffers(submesh, a_mesh.display_position,
+                                 a_mesh.display_normals, a_mesh.VBOs);
+      break;
+    case submesh_upload::soft_skinned:
+      gpu_update_submesh_buffers(submesh, a_mesh.soft_skinned_position,
+                                 a_mesh.soft_skinned_normals, a_mesh.VBOs);
+      break;
+    case submesh_upload::skinning_pass_input:
+      a_mesh.upload_skinning_pass_input(submesh);
+      break;
+    case submesh_upload::none:
+      break;
   }
 }
 
+std::vector<size_t> app::add_transform_tasks(task_graph& graph) {
+  std::vector<size_t> tasks;
+  auto& scene = flat_scene_graph;
+  recomputed_transforms = 0;
+  if (scene.size() == 0) return tasks;
+
+  // Small scenes are updated in one go, splitting them costs more than it
+  // saves
+  const auto threshold =
+      size_t(std::max(0, configuration::parallel_transform_threshold));
+  if (scene.size() < threshold) {
+    tasks.push_back(graph.add("transforms", [this, &scene] {
+      recomputed_transforms += scene.update(0, scene.size());
+    }));
+    return tasks;
+  }
+
+  // A few chunks per thread, so they can be balanced by stealing. The nodes
+  // above the chunks are done right away.
+  const size_t chunk_size =
+      std::max(size_t(256), scene.size() / (4 * scheduler.thread_count()));
+  scene.partition(chunk_size, transform_serial_nodes, transform_chunks);
+  for (const auto node : transform_serial_nodes)
+    recomputed_transforms += scene.update(node, node + 1);
+
+  for (const auto& chunk : transform_chunks) {
+    const size_t begin = chunk.first;
+    const size_t end = chunk.second;
+    tasks.push_back(graph.add(
+        "transforms " + std::to_string(begin) + "-" + std::to_string(end),
+        [this, &scene, begin, end] {
+          recomputed_transforms += scene.update(begin, end);
+        }));
+  }
+
+  return tasks;
+}
+
 void app::soft_skinning_controls(bool& gpu_geometry_buffers_dirty) {
   if (ImGui::Checkbox("Software skinning", &do_soft_skinning)) {
     if (!do_soft_skinning)  // if we clicked on this, and we are not doing
@@ -1737,6 +2226,33 @@ void app::soft_skinning_controls(bool& gpu_geometry_buffers_dirty) {
       gpu_geometry_buffers_dirty = true;
     }
   }
+
+  ImGui::Checkbox("Fused morph and skin", &fused_deformation);
+  ImGui::Checkbox("GPU morphing", &do_gpu_morphing);
+
+  int delta_format = int(morph_deltas);
+  if (ImGui::Combo("Morph deltas", &delta_format,
+                   "32 bit float\0Half float\0int16\0")) {
+    morph_deltas = morph_delta_format(delta_format);
+    // The deltas are packed at load
+    reload_asset = asset_loaded;
+  }
+
+  ImGui::Checkbox("Check skinning against the reference", &check_skinning);
+
+  int method = int(skinning);
+  if (ImGui::Combo("Skinning method", &method,
+                   "Linear blend\0Dual quaternion\0")) {
+    skinning = skinning_method(method);
+    // The GPU skinning pass is built for one method
+    if (skinning_pass.get_program() != 0)
+      skinning_pass = load_skinning_pass_shader(skinning, morph_deltas);
+    for (auto& a_mesh : loaded_meshes) {
+      if (!a_mesh.skinned) continue;
+      a_mesh.soft_skinning_dirty = true;
+      a_mesh.joint_palette_dirty = true;
+    }
+  }
 }
 
 void app::mouse_ray_debug_control() {
@@ -1765,13 +2281,189 @@ void app::find_gltf_node_index_for_active_joint(
 void app::update_geometry(bool gpu_geometry_buffers_dirty,
                           int& active_joint_gltf_node) {
   active_joint_gltf_node = -1;
-  for (auto& a_mesh : loaded_meshes) {
+  for (auto& a_mesh : loaded_meshes)
     find_gltf_node_index_for_active_joint(active_joint_gltf_node, a_mesh);
-    if (a_mesh.skinned)
-      compute_joint_matrices(root_node_model_matrix, a_mesh.joint_matrices,
-                             a_mesh.flat_joint_list,
-                             a_mesh.inverse_bind_matrices);
-    perform_skinning_and_morphing(gpu_geometry_buffers_dirty, a_mesh);
+
+  // Transform propagation -> joint matrices -> deformation of each submesh,
+  // the meshes are independent from each other
+  task_graph graph;
+  const auto transform_tasks = add_transform_tasks(graph);
+  skinned_vertices = 0;
+  skinning_nanoseconds = 0;
+  deformation_nanoseconds = 0;
+  deformation_bytes = 0;
+
+  // Number of vertices deformed by each task
+  const size_t chunk_size = 16384;
+  std::vector<std::vector<submesh_deformation>> deformations(
+      loaded_meshes.size());
+  for (size_t m = 0; m < loaded_meshes.size(); ++m) {
+    auto& a_mesh = loaded_meshes[m];
+    deformations[m].resize(a_mesh.draw_call_descriptors.size());
+
+    const size_t joint_task =
+        graph.add("joint matrices " + a_mesh.name, [this, &a_mesh] {
+          if (!a_mesh.skinned) return;
+          a_mesh.previous_joint_matrices.swap(a_mesh.joint_matrices);
+          a_mesh.joint_matrices.resize(a_mesh.previous_joint_matrices.size());
+          compute_joint_matrices(root_node_model_matrix, a_mesh.joint_matrices,
+                                 a_mesh.flat_joint_list,
+                                 a_mesh.inverse_bind_matrices);
+
+          // The skinned vertices and the joint palette only need to be
+          // computed again if the skeleton moved
+          const bool moved =
+              memcmp(a_mesh.joint_matrices.data(),
+                     a_mesh.previous_joint_matrices.data(),
+                     a_mesh.joint_matrices.size() * sizeof(affine)) != 0;
+          if (moved) a_mesh.joint_palette_dirty = true;
+          if (!do_soft_skinning || moved) a_mesh.soft_skinning_dirty = true;
+          if (do_soft_skinning ? !a_mesh.soft_skinning_dirty
+                               : !a_mesh.joint_palette_dirty)
+            return;
+          if (skinning == skinning_method::dual_quaternion)
+            build_dual_quaternion_palette(a_mesh.joint_matrices,
+                                          a_mesh.joint_dual_quaternions);
+          else if (do_soft_skinning)
+            build_skinning_palette(a_mesh.joint_matrices,
+                                   a_mesh.skinning_palette);
+        });
+    for (const auto transform_task : transform_tasks)
+      graph.depend(joint_task, transform_task);
+
+    // The vertices of a submesh are deformed by chunks, so big meshes are
+    // spread over all the threads
+    for (size_t submesh = 0; submesh < deformations[m].size(); ++submesh) {
+      const auto& deformation = deformations[m][submesh] =
+          plan_submesh_deformation(gpu_geometry_buffers_dirty, a_mesh,
+                                   submesh);
+      if (!deformation.morph && !deformation.skin) continue;
+
+      const size_t vertex_count = a_mesh.display_position[submesh].size() / 3;
+      for (size_t begin = 0; begin < vertex_count; begin += chunk_size) {
+        const size_t end = std::min(vertex_count, begin + chunk_size);
+        const size_t deform_task = graph.add(
+            "deform " + a_mesh.name + " #" + std::to_string(submesh) + " [" +
+                std::to_string(begin) + "; " + std::to_string(end) + ")",
+            [this, &a_mesh, submesh, &deformation, begin, end] {
+              deform_submesh_vertices(a_mesh, submesh, deformation, begin,
+                                      end);
+            });
+        graph.depend(deform_task, joint_task);
+      }
+    }
+  }
+
+  scheduler.run(graph);
+  geometry_task_timings = graph.timings();
+
+  frame_stats.deformable_submeshes = 0;
+  frame_stats.skipped_submeshes = 0;
+  frame_stats.gpu_morphed_submeshes = 0;
+  static const char* const delta_formats[] = {"32 bit float", "half float",
+                                              "int16"};
+  frame_stats.morph_delta_format = delta_formats[int(morph_deltas)];
+  frame_stats.morph_delta_bytes = frame_stats.morph_delta_float_bytes = 0;
+  frame_stats.morph_delta_position_error = 0.f;
+  frame_stats.morph_delta_normal_error = 0.f;
+  for (const auto& a_mesh : loaded_meshes) {
+    const auto& packing = a_mesh.morph_packing;
+    frame_stats.morph_delta_bytes += packing.bytes;
+    frame_stats.morph_delta_float_bytes += packing.float_bytes;
+    frame_stats.morph_delta_position_error = std::max(
+        frame_stats.morph_delta_position_error, packing.max_position_error);
+    frame_stats.morph_delta_normal_error = std::max(
+        frame_stats.morph_delta_normal_error, packing.max_normal_error);
+  }
+  // Keep showing the last frame that did skin something
+  if (skinned_vertices > 0) {
+    frame_stats.skinned_vertices = skinned_vertices;
+    frame_stats.skinning_time = double(skinning_nanoseconds) / 1e6;
+    frame_stats.skinning_method =
+        skinning == skinning_method::dual_quaternion ? "dual quaternion"
+                                                     : "linear blend";
+  }
+  size_t active_morph_targets = 0, nb_morph_targets = 0;
+  skinning_error skinning_check;
+  for (size_t m = 0; m < loaded_meshes.size(); ++m) {
+    auto& a_mesh = loaded_meshes[m];
+    for (size_t submesh = 0; submesh < deformations[m].size(); ++submesh) {
+      auto& deformation = deformations[m][submesh];
+      if (!deformation.deformable) continue;
+      // Same condition as deform_submesh_vertices(), the skinned vertices
+      // come from the display vertices
+      const bool skinned =
+          deformation.skin && !deformation.fused &&
+          (deformation.morph || a_mesh.soft_skinning_dirty);
+      if (check_skinning && skinned &&
+          skinning == skinning_method::linear_blend) {
+        const auto error = check_skinned_vertices(
+            a_mesh.joint_matrices, a_mesh.influences[submesh], 0,
+            a_mesh.influences[submesh].vertex_count,
+            a_mesh.display_position[submesh].data(),
+            a_mesh.display_normals[submesh].data(),
+            a_mesh.soft_skinned_position[submesh].data(),
+            a_mesh.soft_skinned_normals[submesh].data());
+        skinning_check.vertex_count += error.vertex_count;
+        skinning_check.position =
+            std::max(skinning_check.position, error.position);
+        skinning_check.normal = std::max(skinning_check.normal, error.normal);
+      }
+      frame_stats.deformable_submeshes++;
+      if (a_mesh.morph_states[submesh].gpu_morphed)
+        frame_stats.gpu_morphed_submeshes++;
+      if (deformation.morph || deformation.fused) {
+        active_morph_targets += deformation.blend.weights.size();
+        nb_morph_targets += a_mesh.morph_targets[submesh].size();
+      }
+
+      // Soft skinned vertices that were not skinned again are still on the GPU
+      if (deformation.upload == submesh_upload::soft_skinned &&
+          !deformation.morph && !a_mesh.soft_skinning_dirty)
+        deformation.upload = submesh_upload::none;
+      if (deformation.upload == submesh_upload::none && !deformation.gpu_morph)
+        frame_stats.skipped_submeshes++;
+    }
+    if (do_soft_skinning) a_mesh.soft_skinning_dirty = false;
+  }
+  // Keep showing the last frame that was checked
+  if (skinning_check.vertex_count > 0)
+    frame_stats.skinning_check = skinning_check;
+  if (deformation_bytes > 0) {
+    frame_stats.deformation_time = double(deformation_nanoseconds) / 1e6;
+    frame_stats.deformation_bytes = deformation_bytes;
+    frame_stats.deformation_pass = fused_deformation ? "fused" : "separate";
+    frame_stats.active_morph_targets = active_morph_targets;
+    frame_stats.nb_morph_targets = nb_morph_targets;
+  }
+
+  // OpenGL calls stay on this thread. The joint palette of each skeleton is
+  // uploaded once, whatever the number of submeshes drawn with it.
+  if (!do_soft_skinning)
+    for (auto& a_mesh : loaded_meshes)
+      if (a_mesh.skinned && a_mesh.joint_palette_dirty)
+        a_mesh.upload_joint_palette(skinning);
+  for (size_t m = 0; m < loaded_meshes.size(); ++m)
+    for (size_t submesh = 0; submesh < deformations[m].size(); ++submesh)
+      upload_deformed_submesh(loaded_meshes[m], submesh,
+                              deformations[m][submesh].upload);
+
+  // Morph and skin each submesh once, for all the passes that draw it this
+  // frame
+  for (size_t m = 0; m < loaded_meshes.size(); ++m) {
+    auto& a_mesh = loaded_meshes[m];
+    const bool gpu_skinning = a_mesh.skinned && !do_soft_skinning;
+    for (size_t submesh = 0; submesh < deformations[m].size(); ++submesh) {
+      const auto& deformation = deformations[m][submesh];
+      if (deformation.gpu_morph ||
+          (gpu_skinning &&
+           (a_mesh.skinning_pass_dirty ||
+            deformation.upload == submesh_upload::skinning_pass_input)))
+        a_mesh.run_skinning_pass(submesh,
+                                 a_mesh.skinned ? skinning_pass : morph_pass,
+                                 gltf_scene_tree.pose.blend_weights);
+    }
+    if (gpu_skinning) a_mesh.skinning_pass_dirty = false;
   }
 }
 
@@ -1800,6 +2492,20 @@ bool app::main_loop_frame() {
       ImGui::ShowDemoWindow(&show_imgui_demo);
     }
 
+    if (reload_asset) {
+      reload_asset = false;
+      const auto filename = input_filename;
+      unload();
+      input_filename = filename;
+      try {
+        load();
+      } catch (const std::exception& e) {
+        std::cerr << "error occured during loading of " << input_filename
+                  << ": " << e.what() << '\n';
+        unload();
+      }
+    }
+
     if (open_file_dialog) {
 #if defined(GLTF_INSIGHT_WITH_NATIVEFILEDIALOG)
       // TODO(LTE): Run into modal mode in ImGui while opening NFD window.
@@ -1889,6 +2595,11 @@ bool app::main_loop_frame() {
       model_info_window(model, &show_model_info_window);
       asset_images_window(textures, &show_asset_image_window);
       animation_window(animations, &show_animation_window);
+      frame_stats.recomputed_transforms = recomputed_transforms;
+      frame_stats.nb_nodes = flat_scene_graph.size();
+      profiler_window(animation_task_timings, geometry_task_timings,
+                      scheduler.thread_count(), frame_stats,
+                      &show_profiler_window);
       mesh_display_window(loaded_meshes, &show_mesh_display_window);
       morph_target_window(gltf_scene_tree,
                           loaded_meshes.front().nb_morph_targets,
@@ -1916,6 +2627,7 @@ bool app::main_loop_frame() {
     // Animation player advances time and apply animation interpolation.
     // It also display the sequencer timeline and controls on screen
 
+    pose_baker.update(animations, configuration::bake_pose_cache);
     run_animation_timeline(sequence, looping, selectedEntry, firstFrame,
                            expanded, currentFrame, currentPlayTime,
                            last_frame_time, playing_state, animations);
@@ -2076,27 +2788,6 @@ void app::generate_joint_inverse_bind_matrix_map(
   }
 }
 
-void app::cpu_compute_morphed_display_mesh(
-    gltf_node mesh_skeleton_graph, size_t submesh_id,
-    const std::vector<std::vector<morph_target>>& morph_targets,
-    const std::vector<std::vector<float>>& vertex_coord,
-    const std::vector<std::vector<float>>& normals,
-    std::vector<std::vector<float>>& display_position,
-    std::vector<std::vector<float>>& display_normal, size_t vertex) {
-  // Get the base vector
-  display_position[submesh_id][vertex] = vertex_coord[submesh_id][vertex];
-  display_normal[submesh_id][vertex] = normals[submesh_id][vertex];
-
-  // Accumulate the delta, v = v0 + w0 * m0 + w1 * m1 + w2 * m2 ...
-  for (size_t w = 0; w < mesh_skeleton_graph.pose.blend_weights.size(); ++w) {
-    const float weight = mesh_skeleton_graph.pose.blend_weights[w];
-    display_position[submesh_id][vertex] +=
-        weight * morph_targets[submesh_id][w].position[vertex];
-    display_normal[submesh_id][vertex] +=
-        weight * morph_targets[submesh_id][w].normal[vertex];
-  }
-}
-
 void app::gpu_update_submesh_buffers(
     size_t submesh_id, std::vector<std::vector<float>>& display_position,
     std::vector<std::vector<float>>& display_normal,
@@ -2137,145 +2828,125 @@ void app::gpu_update_submesh_skinning_data(
                joint[submesh_id].data(), GL_DYNAMIC_DRAW);
 }
 
-void app::perform_software_morphing(
-    gltf_node mesh_skeleton_graph, size_t submesh_id,
+void app::gather_active_morph_targets(
+    const gltf_node& mesh_skeleton_graph,
+    const std::vector<morph_target>& morph_targets, size_t vertex_count,
+    morph_blend& blend) {
+  const auto& weights = mesh_skeleton_graph.pose.blend_weights;
+  for (size_t t = 0; t < std::min(weights.size(), morph_targets.size()); ++t) {
+    // A target with a zero weight doesn't move anything
+    if (weights[t] == 0.f) continue;
+    const auto& target = morph_targets[t];
+    if (!target.moves_vertices) continue;
+    // The blend reads a delta for each vertex of a dense target
+    const bool dense = target.indices.empty();
+    const size_t values = 3 * vertex_count;
+    if (dense && (target.packed_position.size() != values ||
+                  target.packed_normal.size() != values)) {
+      std::cerr << "Warn: skipping morph target " << t << ", it has "
+                << target.packed_position.size() / 3 << " deltas for "
+                << vertex_count << " vertices\n";
+      continue;
+    }
+    blend.add(target.packed_position, target.packed_normal,
+              dense ? nullptr : target.indices.data(),
+              target.indices.size(), weights[t]);
+  }
+}
+
+void app::software_morph_vertices(
+    const morph_blend& blend, size_t submesh_id,
+    const std::vector<std::vector<float>>& vertex_coord,
+    const std::vector<std::vector<float>>& normals,
+    std::vector<std::vector<float>>& display_position,
+    std::vector<std::vector<float>>& display_normal, size_t begin,
+    size_t end) {
+  // Blend the vertices between morph targets on the CPU
+  morph_vertices(blend, begin, end, vertex_coord[submesh_id].data(),
+                 normals[submesh_id].data(),
+                 display_position[submesh_id].data(),
+                 display_normal[submesh_id].data());
+}
+
+bool app::perform_software_morphing(
+    const gltf_node& mesh_skeleton_graph, size_t submesh_id,
+    submesh_morph_state& morph_state,
     const std::vector<std::vector<morph_target>>& morph_targets,
     const std::vector<std::vector<float>>& vertex_coord,
     const std::vector<std::vector<float>>& normals,
     std::vector<std::vector<float>>& display_position,
     std::vector<std::vector<float>>& display_normal,
     std::vector<std::array<GLuint, VBO_count>>& VBOs, bool upload_to_gpu) {
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wexit-time-destructors"
-#endif
-  // evaluation cache:
-  static std::vector<bool> clean;
-  static std::vector<std::vector<float>> cached_weights;
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
-
   if (mesh_skeleton_graph.pose.blend_weights.size() > 0 &&
       morph_targets[submesh_id].size() > 0) {
     assert(display_position[submesh_id].size() ==
            display_normal[submesh_id].size());
 
-    // We are dynamically keeping a cache of the morph targets weights. CPU-side
-    // evaluation of morphing is expensive, if the blending weights did not
-    // change, we don't want to re-evaluate the mesh.
-
-    // We are keeping a cache of the weights, and setting a dirty flags if we
-    // need to recompute it.
-
-    // To transparently handle the loading of a different file, we resize these
-    // arrays here
-    if (cached_weights.size() != display_position.size()) {
-      cached_weights.resize(display_position.size());
-      clean.resize(display_position.size());
-
-      // This sets all the dirty flags to "dirty"
-      std::generate(clean.begin(), clean.end(), [] { return false; });
-    }
-
-    // If the number of blendshape doesn't match, we are just copying the array
-    if (cached_weights[submesh_id].size() !=
-        mesh_skeleton_graph.pose.blend_weights.size()) {
-      clean[submesh_id] = false;
-      cached_weights[submesh_id] = mesh_skeleton_graph.pose.blend_weights;
-    }
-
-    // ElseIf the size matches, we are comparing all the elements (using
-    // std::vector<> operator==()), if they match, it means that mesh doesn't
-    // need to be evaluated
-    else if (cached_weights[submesh_id] ==
-             mesh_skeleton_graph.pose.blend_weights) {
-      clean[submesh_id] = true;
-    }
+    // CPU-side evaluation of morphing is expensive, it is skipped when the
+    // display vertices already match the blending weights
+    morph_state.update(mesh_skeleton_graph.pose.blend_weights);
+    if (morph_state.display_dirty()) {
+      morph_blend blend;
+      gather_active_morph_targets(mesh_skeleton_graph,
+                                  morph_targets[submesh_id],
+                                  vertex_coord[submesh_id].size() / 3, blend);
+      software_morph_vertices(blend, submesh_id, vertex_coord, normals,
+                              display_position, display_normal, 0,
+                              display_position[submesh_id].size() / 3);
 
-    // Else, In that case, we are updating the cache, and setting the flag dirty
-    else {
-      clean[submesh_id] = false;
-      cached_weights[submesh_id] = mesh_skeleton_graph.pose.blend_weights;
-    }
-
-    // If flag is found to be dirty
-    if (!clean[submesh_id]) {
-      // Blend each vertex between morph targets on the CPU:
-      for (size_t vertex = 0; vertex < display_position[submesh_id].size();
-           ++vertex) {
-        cpu_compute_morphed_display_mesh(
-            mesh_skeleton_graph, submesh_id, morph_targets, vertex_coord,
-            normals, display_position, display_normal, vertex);
-      }
+      morph_state.display_generation = morph_state.generation;
 
       // If it is necessary to upload the new mesh data to the GPU, do it:
-      if (upload_to_gpu)
+      if (upload_to_gpu) {
         gpu_update_submesh_buffers(submesh_id, display_position, display_normal,
                                    VBOs);
+        morph_state.drawn_generation = morph_state.generation;
+      }
+      return true;
     }
   }
-}
 
-void app::perform_software_skinning(
-    size_t submesh_id, const std::vector<glm::mat4>& joint_matrix,
-    const std::vector<std::vector<float>>& positions,
-    const std::vector<std::vector<float>>& normals,
-    const std::vector<std::vector<unsigned short>>& joints,
-    const std::vector<std::vector<float>>& weights,
-    std::vector<std::vector<float>>& display_position,
-    std::vector<std::vector<float>>& display_normal) {
-  // TODO only perform this computation if the joints have moved
+  return false;
+}
 
-  // Fetch the arrays for the current primitive
-  const auto& prim_positions = positions[submesh_id];
-  const auto& prim_normals = normals[submesh_id];
-  const auto& prim_joints = joints[submesh_id];
-  const auto& prim_weights = weights[submesh_id];
-  const auto vertex_count = prim_joints.size() / 4;
+void app::perform_software_skinning(mesh& a_mesh, size_t submesh_id,
+                                    size_t begin, size_t end,
+                                    const morph_blend* morph) {
+  // Fetch the arrays for the current primitive. The fused pass morphs the
+  // base vertices itself.
+  const auto& prim_positions = morph ? a_mesh.positions[submesh_id]
+                                     : a_mesh.display_position[submesh_id];
+  const auto& prim_normals = morph ? a_mesh.normals[submesh_id]
+                                   : a_mesh.display_normals[submesh_id];
+  const auto& prim_influences = a_mesh.influences[submesh_id];
+  const auto vertex_count = prim_influences.vertex_count;
 
   // We need the data sizes to match for what we do to work
   assert(prim_positions.size() / 3 == vertex_count &&
-         prim_normals.size() / 3 == vertex_count &&
-         prim_joints.size() / 4 == vertex_count &&
-         prim_weights.size() / 4 == vertex_count);
-
-  for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
-    using namespace glm;
-
-    vec3 output_position, output_normal;
-    auto input_positions =
-        vec3(prim_positions[3 * vertex + 0], prim_positions[3 * vertex + 1],
-             prim_positions[3 * vertex + 2]);
-    auto input_normals =
-        vec3(prim_normals[3 * vertex + 0], prim_normals[3 * vertex + 1],
-             prim_normals[3 * vertex + 2]);
-    auto input_joints =
-        vec4(prim_joints[4 * vertex + 0], prim_joints[4 * vertex + 1],
-             prim_joints[4 * vertex + 2], prim_joints[4 * vertex + 3]);
-    auto input_weights =
-        vec4(prim_weights[4 * vertex + 0], prim_weights[4 * vertex + 1],
-             prim_weights[4 * vertex + 2], prim_weights[4 * vertex + 3]);
-
-    // TODO it is possible to support more than 4 joints per vertex, but not
-    // required by glTF spec
-    const mat4 skin_matrix =
-        input_weights.x * joint_matrix[size_t(input_joints.x)] +
-        input_weights.y * joint_matrix[size_t(input_joints.y)] +
-        input_weights.z * joint_matrix[size_t(input_joints.z)] +
-        input_weights.w * joint_matrix[size_t(input_joints.w)];
-
-    auto skinned_position = skin_matrix * vec4(input_positions, 1.f);
-    auto normal_skin_matrix = mat3(transpose(inverse(skin_matrix)));
-
-    output_position = vec3(skinned_position) / skinned_position.w;
-    output_normal = normal_skin_matrix * input_normals;
-
-    memcpy(&display_position[submesh_id][3 * vertex],
-           value_ptr(output_position), 3 * sizeof(float));
-    memcpy(&display_normal[submesh_id][3 * vertex], value_ptr(output_normal),
-           3 * sizeof(float));
-  }
+         prim_normals.size() / 3 == vertex_count);
+
+  end = std::min(end, vertex_count);
+  if (begin >= end) return;
+  auto* skinned_positions = a_mesh.soft_skinned_position[submesh_id].data();
+  auto* skinned_normals = a_mesh.soft_skinned_normals[submesh_id].data();
+  if (morph && skinning == skinning_method::dual_quaternion)
+    morph_and_skin_vertices(a_mesh.joint_dual_quaternions, prim_influences,
+                            *morph, begin, end, prim_positions.data(),
+                            prim_normals.data(), skinned_positions,
+                            skinned_normals);
+  else if (morph)
+    morph_and_skin_vertices(a_mesh.skinning_palette, prim_influences, *morph,
+                            begin, end, prim_positions.data(),
+                            prim_normals.data(), skinned_positions,
+                            skinned_normals);
+  else if (skinning == skinning_method::dual_quaternion)
+    skin_vertices(a_mesh.joint_dual_quaternions, prim_influences, begin, end,
+                  prim_positions.data(), prim_normals.data(),
+                  skinned_positions, skinned_normals);
+  else
+    skin_vertices(a_mesh.skinning_palette, prim_influences, begin, end,
+                  prim_positions.data(), prim_normals.data(),
+                  skinned_positions, skinned_normals);
 }
 
 void app::draw_bone_overlay(gltf_node& mesh_skeleton_graph,
@@ -2297,7 +2968,7 @@ void app::draw_bone_overlay(gltf_node& mesh_skeleton_graph,
 }
 
 void app::compute_joint_matrices(
-    glm::mat4& model_matrix, std::vector<glm::mat4>& joint_matrices,
+    glm::mat4& model_matrix, std::vector<affine>& joint_matrices,
     std::vector<gltf_node*>& flat_joint_list,
     std::vector<glm::mat4>& inverse_bind_matrices) {
   // This compute the individual joint matrices that are uploaded to the
@@ -2309,10 +2980,11 @@ void app::compute_joint_matrices(
   // Sascha Willems's "vulkan-glTF-PBR" code...
   // https://github.com/SaschaWillems/Vulkan-glTF-PBR/blob/master/base/VulkanglTFModel.hpp
 
-  const glm::mat4 inverse_model = glm::inverse(model_matrix);
+  const affine inverse_model = affine_from_mat4(glm::inverse(model_matrix));
   for (size_t i = 0; i < joint_matrices.size(); ++i) {
-    joint_matrices[i] = inverse_model * flat_joint_list[i]->world_xform *
-                        inverse_bind_matrices[i];
+    joint_matrices[i] = inverse_model *
+                        affine_from_mat4(flat_joint_list[i]->world_xform) *
+                        affine_from_mat4(inverse_bind_matrices[i]);
   }
 }
 
@@ -2345,13 +3017,39 @@ void app::run_animation_timeline(gltf_insight::AnimSequence& _sequence,
     _currentPlayTime = double(_currentFrame) / double(ANIMATION_FPS);
   }
 
+  // Each animation is sampled in its own task. Animations that write to the
+  // same node keep their order.
+  task_graph graph;
+  std::map<const gltf_node*, size_t> last_writer;
   for (auto& anim : _animations) {
     anim.set_time(float(_currentPlayTime));  // TODO handle timeline position
     // of animaiton sequence
     anim.playing = _playing_state;
-    if (need_to_update_pose || _playing_state) anim.apply_pose();
+    if (!need_to_update_pose && !_playing_state) continue;
+
+    animation* a = &anim;
+    const size_t task =
+        graph.add("pose " + anim.name, [a] { a->apply_pose(); });
+
+    std::vector<size_t> dependencies;
+    for (const auto& channel : anim.channels) {
+      if (!channel.target_graph_node) continue;
+      auto writer = last_writer.find(channel.target_graph_node);
+      if (writer != last_writer.end() &&
+          std::find(dependencies.begin(), dependencies.end(),
+                    writer->second) == dependencies.end()) {
+        dependencies.push_back(writer->second);
+        graph.depend(task, writer->second);
+      }
+    }
+    for (const auto& channel : anim.channels)
+      if (channel.target_graph_node)
+        last_writer[channel.target_graph_node] = task;
   }
 
+  scheduler.run(graph);
+  animation_task_timings = graph.timings();
+
   last_frame_time = current_time;
 }
 
@@ -2391,7 +3089,7 @@ void app::run_3D_gizmo(gltf_node* active_bone) {
 
       // Compute the world transform
       bind_matrix = glm::inverse(a_mesh->inverse_bind_matrices[joint_index]);
-      joint_matrix = a_mesh->joint_matrices[joint_index];
+      joint_matrix = affine_to_mat4(a_mesh->joint_matrices[joint_index]);
       bone_world_xform = mesh_node->world_xform * joint_matrix * bind_matrix;
     } else {
 	  // FIXME(LTE): Do not exit.
@@ -2438,6 +3136,9 @@ void app::run_3D_gizmo(gltf_node* active_bone) {
   if (current_mode != saved_mode)
     return;  // If we just gone from mesh to bone, we are not manipulating the
 
+  // Both the transform window and the gizmo may move the mesh below
+  const glm::mat4 saved_model_matrix = root_node_model_matrix;
+
   // If any of these values has been changed in the GUI, recompose the
   // manipulated matrix from these TRS vectors
   if (savedTr != vecTranslation || savedRot != vecRotation ||
@@ -2460,6 +3161,12 @@ void app::run_3D_gizmo(gltf_node* active_bone) {
         static_cast<float*>(glm::value_ptr(delta_matrix)));
   }
 
+  // The model matrix is the local transform of the root of the scene. Moving
+  // it moves the whole scene.
+  if (current_mode == manipulate_mesh &&
+      root_node_model_matrix != saved_model_matrix)
+    gltf_scene_tree.mark_transform_dirty();
+
   // If we are manipulating the mesh, the matrix has been updated as it should
   // have been. However, if we are manipulating a joint, we need to update the
   // "pose" information of that joint, not that joint transform matrix. The
@@ -2502,10 +3209,9 @@ void app::run_3D_gizmo(gltf_node* active_bone) {
       glm::decompose(currently_posed, scale, rotation, position, skew,
                      perspective);
 
-      gltf_node::animation_state& pose = active_bone->pose;
-      pose.translation = position;
-      pose.rotation = rotation;
-      pose.scale = scale;
+      active_bone->set_pose_translation(position);
+      active_bone->set_pose_rotation(rotation);
+      active_bone->set_pose_scale(scale);
     }
   }
 }
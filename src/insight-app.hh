@@ -32,11 +32,16 @@ SOFTWARE.
 #include "animation.hh"
 #include "configuration.hh"
 #include "material.hh"
+#include "pose-cache.hh"
+#include "skinning.hh"
+#include "task-scheduler.hh"
 
 // This includes opengl for us, along side debuging callbacks
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <vector>
 
@@ -131,6 +136,33 @@ struct color_identifier {
 
 #pragma pack(pop)
 
+/// Morph evaluation state of a submesh. The morph target weights are compared
+/// with a snapshot of the last ones seen, and every change bumps the
+/// generation. Each set of deformed vertices remembers the generation it was
+/// computed from, so it is only evaluated again when it is out of date.
+struct submesh_morph_state {
+  /// Weights of the current generation
+  std::vector<float> weights;
+  uint32_t generation = 1;
+  /// Generation of the morphed display vertices
+  uint32_t display_generation = 0;
+  /// Generation of the vertices that are drawn. They differ from the display
+  /// ones when the fused morph and skin pass or the GPU pass morphed them.
+  uint32_t drawn_generation = 0;
+  /// Set when the submesh is morphed on the GPU, by the skinning pass. The
+  /// input of the pass then holds its base vertices.
+  bool gpu_morphed = false;
+
+  /// Snapshot `new_weights`, and start a new generation if they changed
+  void update(const std::vector<float>& new_weights) {
+    if (weights == new_weights) return;
+    weights = new_weights;
+    ++generation;
+  }
+  bool display_dirty() const { return display_generation != generation; }
+  bool drawn_dirty() const { return drawn_generation != generation; }
+};
+
 struct mesh {
   static color_identifier selection_id_counter;
 
@@ -140,12 +172,31 @@ struct mesh {
   // skinning and morph data
   int nb_joints = 0;
   std::vector<std::vector<unsigned short>> joints;
-  std::vector<glm::mat4> joint_matrices;
+  /// All the joint influences of each submesh. `joints` and `weights` only
+  /// hold the 4 first ones, that are also the vertex attributes.
+  std::vector<skin_influences> influences;
+  std::vector<affine> joint_matrices;
+  /// The joint matrices, as used by software skinning
+  std::vector<skinning_joint> skinning_palette;
+  /// The joint matrices as dual quaternions, for dual quaternion skinning
+  std::vector<dual_quaternion> joint_dual_quaternions;
+  /// Joint matrices of the previous frame, to detect when the skeleton moved
+  std::vector<affine> previous_joint_matrices;
+  /// Set when the software skinned vertices are out of date with the joints
+  bool soft_skinning_dirty = true;
+  /// Set when `joint_palette_texture` is out of date with the joints
+  bool joint_palette_dirty = true;
+  /// Set when the GPU skinning pass needs to run again on every submesh
+  bool skinning_pass_dirty = true;
   std::map<int, int> joint_inverse_bind_matrix_map;
   std::vector<gltf_node*> flat_joint_list;
   std::vector<glm::mat4> inverse_bind_matrices;
   int nb_morph_targets = 0;
   std::vector<std::vector<morph_target>> morph_targets;
+  /// Size and error of the deltas of `morph_targets`, as packed at load
+  morph_packing_stats morph_packing;
+  /// Morph evaluation state of each submesh
+  std::vector<submesh_morph_state> morph_states;
   // if true, mesh has skinning data
   bool skinned = false;
 
@@ -167,13 +218,28 @@ struct mesh {
   std::vector<GLuint> VAOs;
   std::vector<std::array<GLuint, VBO_count>> VBOs;
   std::vector<draw_call_submesh_descriptor> draw_call_descriptors;
-
-  // Each mesh comes with a set of shader objects to be used. They need to be
-  // created after we known some info about the mesh Because gl_util's
-  // load_shader function take templated shader code and substitues values. This
-  // is required for the GPU skinning implementation.
-  std::unique_ptr<std::map<std::string, shader>> shader_list;
-  std::unique_ptr<std::map<std::string, shader>> soft_skin_shader_list;
+  /// Textures holding the influences of the submeshes that have more than 4
+  /// per vertex, for GPU skinning. 0 for the other submeshes.
+  std::vector<GLuint> influence_offset_textures, influence_textures;
+  /// Joint matrices or dual quaternions read by the GPU skinning pass
+  GLuint joint_palette_texture = 0;
+  /// Deltas of all the morph targets of each submesh, read by the pass when
+  /// it morphs the vertices. 0 for the submeshes without targets, or with too
+  /// many of them to fit in a texture.
+  std::vector<GLuint> morph_delta_textures;
+  /// Input of the GPU skinning pass: the position and normal buffers of the
+  /// unskinned vertices, with the joints and weights of `VBOs`. The pass
+  /// writes the skinned vertices to the buffers of `VBOs`, so every draw of the
+  /// submesh uses them as is. Meshes that are morphed but not skinned go
+  /// through the same pass, without skinning.
+  std::vector<GLuint> skinning_pass_VAOs;
+  std::vector<std::array<GLuint, 2>> skinning_pass_VBOs;
+
+  // Set of shader objects this mesh is drawn with. They are owned by the app
+  // and shared by all the meshes.
+  std::map<std::string, shader>* shader_list = nullptr;
+  // Uniform handles of each shader of `shader_list`, under the same names
+  std::map<std::string, draw_uniforms>* uniform_list = nullptr;
 
   // is this mesh displayed on screen
   bool displayed = true;
@@ -186,6 +252,45 @@ struct mesh {
   mesh();
   ~mesh();
 
+  /// Rebuild the influences of a submesh after its first set of joints and
+  /// weights changed, and update its influence textures
+  void update_skin_influences(size_t submesh);
+
+  /// Set the shader uniforms that read the joints and the influences of this
+  /// submesh
+  void bind_skin_influences(size_t submesh, const shader& program) const;
+
+  /// Upload the palette of the active skinning method to
+  /// `joint_palette_texture`
+  void upload_joint_palette(skinning_method method);
+
+  /// Create the input buffers of the GPU skinning pass
+  void create_skinning_pass_buffers();
+
+  /// Pack the deltas of the morph targets in `morph_delta_textures`
+  void create_morph_delta_textures();
+
+  /// Send the vertices of a submesh to the input buffers of the GPU skinning
+  /// pass: the base ones if it is GPU morphed, else the display (morphed on
+  /// the CPU) ones
+  void upload_skinning_pass_input(size_t submesh);
+
+  /// Set the uniforms that morph a GPU morphed submesh by the non zero
+  /// `morph_weights`, or that turn morphing off
+  void bind_morph_targets(size_t submesh, const shader& program,
+                          const std::vector<float>& morph_weights) const;
+
+  /// Morph and skin the vertices of a submesh on the GPU, into its vertex
+  /// buffers
+  void run_skinning_pass(size_t submesh, const shader& pass,
+                         const std::vector<float>& morph_weights) const;
+
+  /// Copy the vertices written by the GPU skinning pass to
+  /// `soft_skinned_position` and `soft_skinned_normals`, or to the display
+  /// vertices of a mesh that is not skinned, for the code that needs them on
+  /// the CPU
+  void read_back_deformed_vertices(size_t submesh);
+
   bool raycast_submesh_camera_mouse(glm::mat4 world_xform, size_t submesh,
                                     glm::vec3 world_camera_position,
                                     glm::mat4 vp, float x, float y) const;
@@ -252,8 +357,6 @@ class app {
   void run_mouse_click_handler();
   void render_loaded_gltf_scene(int active_bone_gltf_node);
   void update_rendering_matrices();
-  void perform_skinning_and_morphing(bool gpu_geometry_buffers_dirty,
-                                     std::vector<mesh>::value_type& a_mesh);
   void soft_skinning_controls(bool& gpu_geometry_buffers_dirty);
   void mouse_ray_debug_control();
   void find_gltf_node_index_for_active_joint(
@@ -318,18 +421,40 @@ class app {
   bool show_bone_display_window = true;
   bool show_scene_outline_window = true;
   bool do_soft_skinning = true;
+  /// Morph and skin the soft skinned vertices in one pass
+  bool fused_deformation = true;
+  /// Morph the vertices in the GPU pass, when they are not needed on the CPU
+  bool do_gpu_morphing = true;
+  /// Storage of the morph target deltas, on the CPU and the GPU. They are
+  /// packed at load, changing it reloads the asset.
+  morph_delta_format morph_deltas = morph_delta_format::float32;
+  skinning_method skinning = skinning_method::linear_blend;
+  /// Compare the linear blend software skinning of each frame to the slow
+  /// reference implementation. The fused pass is not checked.
+  bool check_skinning = false;
   bool show_debug_ray = false;
   bool show_obj_export_window = true;
+  bool show_profiler_window = false;
 
   std::vector<mesh> loaded_meshes;
   std::vector<material> loaded_material;
   material dummy_material;
 
+  /// Shaders of the meshes, compiled once for the whole asset
+  std::map<std::string, shader> static_shaders;
+  /// Uniform handles of `static_shaders`, resolved when they are loaded
+  std::map<std::string, draw_uniforms> static_shader_uniforms;
+  /// Shader of the GPU skinning pass, for skinned meshes of any joint count
+  shader skinning_pass;
+  /// The pass without skinning, for the morphed meshes that are not skinned
+  shader morph_pass;
+
   // Application state
   bool asset_loaded = false;
   bool found_textured_shader = false;
 
   gltf_node gltf_scene_tree{gltf_node::node_type::empty};
+  flat_scene flat_scene_graph;
 
   ImVec4 viewport_background_color = ImVec4(0.25f, 0.25f, 0.25f, 1.00f);
   tinygltf::Model model;
@@ -348,6 +473,8 @@ class app {
   // user interface state
   bool open_file_dialog = false;
   bool save_file_dialog = false;
+  /// Set to load the asset again at the next frame
+  bool reload_asset = false;
   bool debug_output = false;
   bool show_imgui_demo = false;
   std::string input_filename;
@@ -388,6 +515,25 @@ class app {
   std::vector<GLuint> textures;
   std::vector<animation> animations;
   std::vector<std::string> animation_names;
+  pose_cache_builder pose_baker;
+
+  // CPU side animation and deformation work is spread over these threads
+  task_scheduler scheduler;
+  std::vector<task_timing> animation_task_timings, geometry_task_timings;
+  /// Number of world transforms recomputed by the last frame
+  std::atomic<size_t> recomputed_transforms{0};
+  /// Vertices skinned on the CPU by the last frame, and the time it took
+  std::atomic<size_t> skinned_vertices{0};
+  std::atomic<long long> skinning_nanoseconds{0};
+  /// Time spent morphing and skinning the morphed submeshes by the last
+  /// frame, and the size of the vertex streams it read and wrote
+  std::atomic<long long> deformation_nanoseconds{0};
+  std::atomic<size_t> deformation_bytes{0};
+  /// Draw calls issued by the current draw of the scene
+  size_t scene_draw_calls = 0;
+  std::vector<size_t> transform_serial_nodes;
+  frame_statistics frame_stats;
+  std::vector<std::pair<size_t, size_t>> transform_chunks;
 
   // hidden methods
 
@@ -406,14 +552,6 @@ class app {
       const tinygltf::Skin& skin, const std::vector<int>::size_type nb_joints,
       std::map<int, int>& joint_inverse_bind_matrix_map);
 
-  void cpu_compute_morphed_display_mesh(
-      gltf_node mesh_skeleton_graph, size_t submesh_id,
-      const std::vector<std::vector<morph_target>>& morph_targets,
-      const std::vector<std::vector<float>>& vertex_coord,
-      const std::vector<std::vector<float>>& normals,
-      std::vector<std::vector<float>>& display_position,
-      std::vector<std::vector<float>>& display_normal, size_t vertex);
-
   void gpu_update_submesh_buffers(
       size_t submesh_id, std::vector<std::vector<float>>& display_position,
       std::vector<std::vector<float>>& display_normal,
@@ -424,8 +562,74 @@ class app {
       std::vector<std::vector<unsigned short>>& joint,
       std::vector<std::array<GLuint, VBO_count>>& VBOs);
 
-  void perform_software_morphing(
-      gltf_node mesh_skeleton_graph, size_t submesh_id,
+  /// What needs to be sent to the GPU after a submesh has been deformed.
+  /// With GPU skinning or morphing, the display or base vertices are the
+  /// input of the skinning pass.
+  enum class submesh_upload {
+    none,
+    display,
+    soft_skinned,
+    skinning_pass_input
+  };
+
+  /// What needs to be done to the vertices of a submesh this frame
+  struct submesh_deformation {
+    /// Set if the submesh is morphed or skinned on the CPU at all
+    bool deformable = false;
+    bool morph = false;
+    /// Software skinning is on. The vertices are only skinned again if they
+    /// were morphed or if the skeleton moved (see `mesh::soft_skinning_dirty`)
+    bool skin = false;
+    /// The morph targets are applied by the skinning pass. The display
+    /// vertices are left as is.
+    bool fused = false;
+    /// Targets of the submesh with a non zero weight, if it is morphed
+    morph_blend blend;
+    /// The GPU pass morphs the submesh, and needs to run again
+    bool gpu_morph = false;
+    submesh_upload upload = submesh_upload::none;
+  };
+
+  /// Decide how a submesh needs to be deformed. This checks the morph weights
+  /// cache, so it is called once per submesh and frame.
+  submesh_deformation plan_submesh_deformation(bool gpu_geometry_buffers_dirty,
+                                               mesh& a_mesh, size_t submesh);
+
+  /// Morph and skin the vertices [begin; end) of a submesh on the CPU. This
+  /// doesn't touch OpenGL so it can run on any thread.
+  void deform_submesh_vertices(mesh& a_mesh, size_t submesh,
+                               const submesh_deformation& deformation,
+                               size_t begin, size_t end);
+  void upload_deformed_submesh(mesh& a_mesh, size_t submesh,
+                               submesh_upload upload);
+
+  /// Add to the graph the tasks computing the world transform of the scene.
+  /// Scenes bigger than `configuration::parallel_transform_threshold` are
+  /// split in chunks of subtrees. Return their indices.
+  std::vector<size_t> add_transform_tasks(task_graph& graph);
+
+  /// List the morph targets of a submesh of `vertex_count` vertices that have
+  /// a non zero weight
+  static void gather_active_morph_targets(
+      const gltf_node& mesh_skeleton_graph,
+      const std::vector<morph_target>& morph_targets, size_t vertex_count,
+      morph_blend& blend);
+
+  /// Blend the active morph targets `blend` into the vertices [begin; end) of
+  /// a submesh
+  void software_morph_vertices(
+      const morph_blend& blend, size_t submesh_id,
+      const std::vector<std::vector<float>>& positions,
+      const std::vector<std::vector<float>>& normals,
+      std::vector<std::vector<float>>& display_position,
+      std::vector<std::vector<float>>& display_normal, size_t begin,
+      size_t end);
+
+  /// Morph the display vertices of a submesh if they are older than the
+  /// weights. Return true if the mesh has been re-evaluated
+  bool perform_software_morphing(
+      const gltf_node& mesh_skeleton_graph, size_t submesh_id,
+      submesh_morph_state& morph_state,
       const std::vector<std::vector<morph_target>>& morph_targets,
       const std::vector<std::vector<float>>& positions,
       const std::vector<std::vector<float>>& normals,
@@ -434,14 +638,13 @@ class app {
       std::vector<std::array<GLuint, VBO_count>>& VBOs,
       bool upload_to_gpu = true);
 
+  /// Skin the vertices [begin; end) of a submesh from its display (morphed)
+  /// vertices to its soft skinned ones, with the palette of `skinning`. If
+  /// `morph` is set, the base vertices are morphed and skinned in one go.
   void perform_software_skinning(
-      size_t submesh_id, const std::vector<glm::mat4>& joint_matrices,
-      const std::vector<std::vector<float>>& positions,
-      const std::vector<std::vector<float>>& normals,
-      const std::vector<std::vector<unsigned short>>& joints,
-      const std::vector<std::vector<float>>& weights,
-      std::vector<std::vector<float>>& display_position,
-      std::vector<std::vector<float>>& display_normal);
+      mesh& a_mesh, size_t submesh_id, size_t begin = 0,
+      size_t end = std::numeric_limits<size_t>::max(),
+      const morph_blend* morph = nullptr);
 
   void draw_bone_overlay(gltf_node& mesh_skeleton_graph, int active_joint_node,
                          const glm::mat4& view_matrix,
@@ -450,7 +653,7 @@ class app {
                          const mesh& a_mesh);
 
   void compute_joint_matrices(glm::mat4& model_matrix,
-                              std::vector<glm::mat4>& joint_matrices,
+                              std::vector<affine>& joint_matrices,
                               std::vector<gltf_node*>& flat_joint_list,
                               std::vector<glm::mat4>& inverse_bind_matrices);
 
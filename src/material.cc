@@ -106,50 +106,77 @@ void material::bind_textures() const {
   }
 }
 
-void material::set_shader_uniform(const shader& shading_program) const {
+material_uniforms::material_uniforms(const shader& shading_program)
+    : normal_texture(shading_program.get_uniform<int>("normal_texture")),
+      occlusion_texture(shading_program.get_uniform<int>("occlusion_texture")),
+      emissive_texture(shading_program.get_uniform<int>("emissive_texture")),
+      emissive_factor(
+          shading_program.get_uniform<glm::vec3>("emissive_factor")),
+      alpha_mode(shading_program.get_uniform<int>("alpha_mode")),
+      alpha_cutoff(shading_program.get_uniform<float>("alpha_cutoff")),
+      base_color_texture(
+          shading_program.get_uniform<int>("base_color_texture")),
+      metallic_roughness_texture(
+          shading_program.get_uniform<int>("metallic_roughness_texture")),
+      base_color_factor(
+          shading_program.get_uniform<glm::vec4>("base_color_factor")),
+      metallic_factor(shading_program.get_uniform<float>("metallic_factor")),
+      roughness_factor(shading_program.get_uniform<float>("roughness_factor")),
+      diffuse_texture(shading_program.get_uniform<int>("diffuse_texture")),
+      specular_glossiness_texture(
+          shading_program.get_uniform<int>("specular_glossiness_texture")),
+      diffuse_factor(shading_program.get_uniform<glm::vec4>("diffuse_factor")),
+      specular_factor(
+          shading_program.get_uniform<glm::vec3>("specular_factor")),
+      glossiness_factor(
+          shading_program.get_uniform<float>("glossiness_factor")) {}
+
+void material::set_shader_uniform(const shader& shading_program,
+                                  const material_uniforms& uniforms) const {
   // Bind program to opengl state machine
   shading_program.use();
 
   // set generic material uniform values
-  shading_program.set_uniform("normal_texture", 0);
-  shading_program.set_uniform("occlusion_texture", 1);
-  shading_program.set_uniform("emissive_texture", 2);
-  shading_program.set_uniform("emissive_factor", emissive_factor);
-  shading_program.set_uniform("alpha_mode", int(alpha_mode));
-  shading_program.set_uniform("alpha_cutoff", alpha_cutoff);
+  shading_program.set_uniform(uniforms.normal_texture, 0);
+  shading_program.set_uniform(uniforms.occlusion_texture, 1);
+  shading_program.set_uniform(uniforms.emissive_texture, 2);
+  shading_program.set_uniform(uniforms.emissive_factor, emissive_factor);
+  shading_program.set_uniform(uniforms.alpha_mode, int(alpha_mode));
+  shading_program.set_uniform(uniforms.alpha_cutoff, alpha_cutoff);
 
   // set shader specific material uniform values
   switch (intended_shader) {
     case shading_type::pbr_metal_rough:
-      shading_program.set_uniform("base_color_texture", 3);
-      shading_program.set_uniform("metallic_roughness_texture", 4);
+      shading_program.set_uniform(uniforms.base_color_texture, 3);
+      shading_program.set_uniform(uniforms.metallic_roughness_texture, 4);
       shading_program.set_uniform(
-          "base_color_factor",
+          uniforms.base_color_factor,
           shader_inputs.pbr_metal_roughness.base_color_factor);
       shading_program.set_uniform(
-          "metallic_factor", shader_inputs.pbr_metal_roughness.metallic_factor);
+          uniforms.metallic_factor,
+          shader_inputs.pbr_metal_roughness.metallic_factor);
       shading_program.set_uniform(
-          "roughness_factor",
+          uniforms.roughness_factor,
           shader_inputs.pbr_metal_roughness.roughness_factor);
       break;
 
     case shading_type::pbr_specular_glossy:
-      shading_program.set_uniform("diffuse_texture", 3);
-      shading_program.set_uniform("specular_glossiness_texture", 4);
+      shading_program.set_uniform(uniforms.diffuse_texture, 3);
+      shading_program.set_uniform(uniforms.specular_glossiness_texture, 4);
       shading_program.set_uniform(
-          "diffuse_factor",
+          uniforms.diffuse_factor,
           shader_inputs.pbr_specular_glossiness.diffuse_factor);
       shading_program.set_uniform(
-          "specular_factor",
+          uniforms.specular_factor,
           shader_inputs.pbr_specular_glossiness.specular_factor);
       shading_program.set_uniform(
-          "glossiness_factor",
+          uniforms.glossiness_factor,
           shader_inputs.pbr_specular_glossiness.glossiness_factor);
       break;
 
     case shading_type::unlit:
-      shading_program.set_uniform("base_color_texture", 3);
-      shading_program.set_uniform("base_color_factor",
+      shading_program.set_uniform(uniforms.base_color_texture, 3);
+      shading_program.set_uniform(uniforms.base_color_factor,
                                   shader_inputs.unlit.base_color_factor);
 
       break;
@@ -46,8 +46,7 @@ SOFTWARE.
 #include <array>
 #include <string>
 
-
-class shader;
+#include "shader.hh"
 
 namespace gltf_insight {
 
@@ -101,6 +100,26 @@ static inline std::string to_string(shading_type s) {
 /// The maximum number of texture attachement our shader system can have
 static constexpr size_t max_texture_slots = 6;
 
+/// Handles of the material uniforms of a shader, resolved once
+struct material_uniforms {
+  uniform_handle<int> normal_texture, occlusion_texture, emissive_texture;
+  uniform_handle<glm::vec3> emissive_factor;
+  uniform_handle<int> alpha_mode;
+  uniform_handle<float> alpha_cutoff;
+
+  uniform_handle<int> base_color_texture, metallic_roughness_texture;
+  uniform_handle<glm::vec4> base_color_factor;
+  uniform_handle<float> metallic_factor, roughness_factor;
+
+  uniform_handle<int> diffuse_texture, specular_glossiness_texture;
+  uniform_handle<glm::vec4> diffuse_factor;
+  uniform_handle<glm::vec3> specular_factor;
+  uniform_handle<float> glossiness_factor;
+
+  material_uniforms() = default;
+  explicit material_uniforms(const shader& shading_program);
+};
+
 struct material {
   std::string name = "not_set";
   // Hint about shader to use
@@ -160,7 +179,9 @@ struct material {
 
   void fill_material_texture_slots();
   void bind_textures() const;
-  void set_shader_uniform(const shader& shading_program) const;
+  /// Bind `shading_program` and set the uniforms of this material
+  void set_shader_uniform(const shader& shading_program,
+                          const material_uniforms& uniforms) const;
 };
 
 }  // namespace gltf_insight
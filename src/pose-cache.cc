@@ -0,0 +1,314 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "pose-cache.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "gltf-graph.hh"
+
+size_t pose_cache::byte_size() const {
+  return values.size() * sizeof(float) +
+         quantized_values.size() * sizeof(uint16_t) +
+         (range_min.size() + range_extent.size()) * sizeof(float) +
+         tracks.size() * sizeof(track);
+}
+
+int pose_cache::apply(const animation& anim, float time) const {
+  const int frame = glm::clamp(
+      int(std::floor((time - start_time) * ANIMATION_FPS + 0.5f)), 0,
+      nb_frames - 1);
+  const size_t frame_offset = size_t(frame) * frame_stride;
+
+  const auto value = [&](size_t slot) {
+    if (!quantized) return values[frame_offset + slot];
+    return range_min[slot] + range_extent[slot] *
+                                 float(quantized_values[frame_offset + slot]) /
+                                 65535.f;
+  };
+
+  int inert_channels = 0;
+  for (const auto& t : tracks) {
+    const auto& chan = anim.channels[t.channel_index];
+    if (!chan.target_graph_node || frame < t.first_frame ||
+        frame > t.last_frame) {
+      inert_channels++;
+      continue;
+    }
+
+    auto& node = *chan.target_graph_node;
+    auto& pose = node.pose;
+    switch (chan.mode) {
+      case animation::channel::path::translation:
+        node.set_pose_translation(glm::vec3(
+            value(t.offset), value(t.offset + 1), value(t.offset + 2)));
+        break;
+      case animation::channel::path::scale:
+        node.set_pose_scale(glm::vec3(value(t.offset), value(t.offset + 1),
+                                      value(t.offset + 2)));
+        break;
+      case animation::channel::path::rotation:
+        node.set_pose_rotation(glm::normalize(
+            glm::quat(value(t.offset + 3), value(t.offset),
+                      value(t.offset + 1), value(t.offset + 2))));
+        break;
+      case animation::channel::path::weight:
+        for (size_t w = 0; w < std::min(t.components, pose.blend_weights.size());
+             ++w)
+          pose.blend_weights[w] = value(t.offset + w);
+        break;
+      case animation::channel::path::not_assigned:
+        break;
+    }
+  }
+
+  return inert_channels;
+}
+
+std::shared_ptr<pose_cache> bake_pose_cache(const animation& anim,
+                                            size_t quantize_above_bytes,
+                                            const std::atomic<bool>& cancel) {
+  using clock = std::chrono::high_resolution_clock;
+  const auto start = clock::now();
+
+  auto cache = std::make_shared<pose_cache>();
+  cache->start_time = anim.min_time;
+  cache->nb_frames =
+      std::max(1, int(std::ceil((anim.max_time - anim.min_time) *
+                                ANIMATION_FPS)) +
+                      1);
+
+  for (size_t i = 0; i < anim.channels.size(); ++i) {
+    const auto& chan = anim.channels[i];
+    if (chan.is_static || !chan.target_graph_node) continue;
+
+    pose_cache::track t;
+    t.channel_index = i;
+    t.first_frame = cache->nb_frames;
+    t.last_frame = -1;
+    t.offset = cache->frame_stride;
+    switch (chan.mode) {
+      case animation::channel::path::translation:
+      case animation::channel::path::scale:
+        t.components = 3;
+        break;
+      case animation::channel::path::rotation:
+        t.components = 4;
+        break;
+      case animation::channel::path::weight:
+        t.components = anim.weight_count(chan);
+        break;
+      case animation::channel::path::not_assigned:
+        t.components = 0;
+        break;
+    }
+    if (t.components == 0) continue;
+
+    cache->frame_stride += t.components;
+    cache->tracks.push_back(t);
+  }
+
+  cache->values.resize(size_t(cache->nb_frames) * cache->frame_stride);
+
+  for (int frame = 0; frame < cache->nb_frames; ++frame) {
+    if (cancel) return nullptr;
+
+    const float time = std::min(
+        anim.min_time + float(frame) / ANIMATION_FPS, anim.max_time);
+    float* values = &cache->values[size_t(frame) * cache->frame_stride];
+
+    for (auto& t : cache->tracks) {
+      const auto& chan = anim.channels[t.channel_index];
+      bool sampled;
+      if (chan.mode == animation::channel::path::weight) {
+        sampled =
+            anim.sample_weights(chan, time, values + t.offset, t.components);
+      } else {
+        animation::channel::keyframe_content content;
+        sampled = anim.sample_channel(chan, time, content);
+        if (chan.mode == animation::channel::path::rotation) {
+          values[t.offset + 0] = content.motion.rotation.x;
+          values[t.offset + 1] = content.motion.rotation.y;
+          values[t.offset + 2] = content.motion.rotation.z;
+          values[t.offset + 3] = content.motion.rotation.w;
+        } else {
+          for (size_t c = 0; c < 3; ++c)
+            values[t.offset + c] = content.motion.translation[int(c)];
+        }
+      }
+
+      if (sampled) {
+        t.first_frame = std::min(t.first_frame, frame);
+        t.last_frame = std::max(t.last_frame, frame);
+      }
+    }
+  }
+
+  // Quantize big tables on 16 bits, each float of a frame gets its own range
+  if (cache->values.size() * sizeof(float) > quantize_above_bytes) {
+    const size_t stride = cache->frame_stride;
+    cache->range_min.assign(stride, 0.f);
+    cache->range_extent.assign(stride, 0.f);
+    for (size_t slot = 0; slot < stride; ++slot) {
+      float min = cache->values[slot], max = min;
+      for (size_t frame = 1; frame < size_t(cache->nb_frames); ++frame) {
+        min = std::min(min, cache->values[frame * stride + slot]);
+        max = std::max(max, cache->values[frame * stride + slot]);
+      }
+      cache->range_min[slot] = min;
+      cache->range_extent[slot] = max - min;
+    }
+
+    cache->quantized_values.resize(cache->values.size());
+    for (size_t i = 0; i < cache->values.size(); ++i) {
+      const size_t slot = i % stride;
+      const float extent = cache->range_extent[slot];
+      cache->quantized_values[i] =
+          extent > 0.f
+              ? uint16_t(std::floor(
+                    (cache->values[i] - cache->range_min[slot]) / extent *
+                        65535.f +
+                    0.5f))
+              : 0;
+    }
+
+    std::vector<float>().swap(cache->values);
+    cache->quantized = true;
+  }
+
+  cache->revision = anim.revision;
+  cache->build_milliseconds =
+      std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  return cache;
+}
+
+void pose_cache_builder::update(std::vector<animation>& animations,
+                                bool enabled) {
+  if (!enabled) {
+    cancel();
+    for (auto& anim : animations) anim.baked_poses.reset();
+    return;
+  }
+
+  // Hand the finished tables to their animation
+  for (auto it = jobs.begin(); it != jobs.end();) {
+    auto& j = **it;
+    // Queued for an animation that is gone
+    if (!j.started && j.animation_index >= animations.size()) {
+      it = jobs.erase(it);
+      continue;
+    }
+    if (!j.done) {
+      ++it;
+      continue;
+    }
+
+#ifndef __EMSCRIPTEN__
+    j.worker.join();
+#endif
+    if (j.result && j.animation_index < animations.size() &&
+        animations[j.animation_index].revision == j.revision)
+      animations[j.animation_index].baked_poses = j.result;
+    it = jobs.erase(it);
+  }
+
+  for (size_t i = 0; i < animations.size(); ++i) {
+    auto& anim = animations[i];
+
+    // Drop the tables of edited animations
+    if (anim.baked_poses && anim.baked_poses->revision != anim.revision)
+      anim.baked_poses.reset();
+    if (anim.baked_poses) continue;
+
+    bool running = false;
+    for (auto it = jobs.begin(); it != jobs.end();) {
+      auto& j = **it;
+      if (j.animation_index == i && j.revision != anim.revision) {
+        // Queued jobs have no thread yet, just forget them
+        if (!j.started) {
+          it = jobs.erase(it);
+          continue;
+        }
+        j.cancel = true;
+      } else if (j.animation_index == i) {
+        running = true;
+      }
+      ++it;
+    }
+    if (running) continue;
+
+    std::unique_ptr<job> j(new job);
+    j->animation_index = i;
+    j->revision = anim.revision;
+    jobs.push_back(std::move(j));
+  }
+
+  // Start the queued jobs in order, while fewer than `max_jobs` are baking.
+  // Cancelled jobs count until their thread is done.
+  size_t baking = 0;
+  for (const auto& j : jobs)
+    if (j->started && !j->done) ++baking;
+  for (auto& j : jobs) {
+    if (baking >= max_jobs()) break;
+    if (j->started) continue;
+
+    // The job works on its own copy, the animation can be edited meanwhile
+    auto snapshot = std::make_shared<animation>(animations[j->animation_index]);
+    auto* raw = j.get();
+    const auto bake = [raw, snapshot] {
+      raw->result =
+          bake_pose_cache(*snapshot, quantize_above_bytes, raw->cancel);
+      raw->done = true;
+    };
+
+    j->started = true;
+#ifndef __EMSCRIPTEN__
+    j->worker = std::thread(bake);
+    ++baking;
+#else
+    bake();
+#endif
+  }
+}
+
+size_t pose_cache_builder::max_jobs() {
+#ifndef __EMSCRIPTEN__
+  return std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+#else
+  return 1;
+#endif
+}
+
+void pose_cache_builder::cancel() {
+  for (auto& j : jobs) {
+    j->cancel = true;
+#ifndef __EMSCRIPTEN__
+    if (j->worker.joinable()) j->worker.join();
+#endif
+  }
+  jobs.clear();
+}
+
+pose_cache_builder::~pose_cache_builder() { cancel(); }
@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+#include "animation.hh"
+
+/// All the channels of an animation sampled at ANIMATION_FPS. Fetching a pose
+/// from this table replaces the keyframe search and interpolation of every
+/// channel.
+struct pose_cache {
+  /// Where the values of a channel are stored in a frame
+  struct track {
+    size_t channel_index;
+    /// Range of frames where the channel has a value
+    int first_frame, last_frame;
+    /// Offset and number of floats in a frame
+    size_t offset, components;
+  };
+  std::vector<track> tracks;
+
+  /// Number of floats in a frame
+  size_t frame_stride = 0;
+  int nb_frames = 0;
+  float start_time = 0;
+
+  /// Large clips are stored on 16 bits per value, quantized in the per-float
+  /// range below
+  bool quantized = false;
+  std::vector<float> values;
+  std::vector<uint16_t> quantized_values;
+  std::vector<float> range_min, range_extent;
+
+  /// `animation::revision` this was sampled from
+  int revision = 0;
+
+  /// Time it took to sample the whole animation
+  double build_milliseconds = 0;
+
+  /// Memory used by the table
+  size_t byte_size() const;
+
+  /// Write the pose of the frame at `time` to the nodes animated by `anim`,
+  /// return the number of channels that have no value at this time.
+  int apply(const animation& anim, float time) const;
+};
+
+/// Sample all channels of `anim`. Static channels are not stored as they are
+/// applied once anyway. Clips bigger than `quantize_above_bytes` are stored
+/// quantized. Stop early and return nullptr when `cancel` gets set.
+std::shared_ptr<pose_cache> bake_pose_cache(const animation& anim,
+                                            size_t quantize_above_bytes,
+                                            const std::atomic<bool>& cancel);
+
+/// Bake the pose caches of a set of animations in the background. Each
+/// animation is a job, at most one per hardware thread runs at a time, the
+/// others wait in a queue.
+class pose_cache_builder {
+ public:
+  /// Start baking the animations that don't have a cache yet, hand the
+  /// finished tables to their animation. Caches are dropped when `enabled` is
+  /// false, and rebuilt when an animation revision changes. Call this once
+  /// per frame.
+  void update(std::vector<animation>& animations, bool enabled);
+
+  /// Stop and wait for all running jobs
+  void cancel();
+
+  /// Number of animations queued or being baked
+  size_t pending() const { return jobs.size(); }
+
+  ~pose_cache_builder();
+
+ private:
+  struct job {
+    size_t animation_index;
+    int revision;
+    /// The job got its thread, it is not just queued
+    bool started;
+    std::atomic<bool> done, cancel;
+    std::shared_ptr<pose_cache> result;
+#ifndef __EMSCRIPTEN__
+    std::thread worker;
+#endif
+    job()
+        : animation_index(0),
+          revision(0),
+          started(false),
+          done(false),
+          cancel(false) {}
+  };
+
+  /// In the order they were queued
+  std::vector<std::unique_ptr<job>> jobs;
+
+  /// Number of jobs that can bake at the same time
+  static size_t max_jobs();
+
+  /// Tables bigger than this are quantized
+  static const size_t quantize_above_bytes = 16 * 1024 * 1024;
+};
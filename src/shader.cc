@@ -23,6 +23,8 @@ SOFTWARE.
 */
 #include "shader.hh"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
@@ -32,20 +34,28 @@ SOFTWARE.
 shader::shader(shader&& other) { *this = std::move(other); }
 
 shader& shader::operator=(shader&& other) {
+  if (this == &other) return *this;
+  if (program_ != 0 && glIsProgram(program_) == GL_TRUE)
+    glDeleteProgram(program_);
   program_ = other.program_;
   shader_name_ = std::move(other.shader_name_);
+  uniform_locations_ = std::move(other.uniform_locations_);
+  highlight_color_ = other.highlight_color_;
+  highlight_color_set_ = other.highlight_color_set_;
   other.program_ = 0;
   return *this;
 }
 
 shader::~shader() {
-  if (glIsProgram(program_) == GL_TRUE) glDeleteProgram(program_);
+  if (program_ != 0 && glIsProgram(program_) == GL_TRUE)
+    glDeleteProgram(program_);
 }
 
 shader::shader() {}
 
 shader::shader(const char* shader_name, const char* vertex_shader_source_code,
-               const char* fragment_shader_source_code)
+               const char* fragment_shader_source_code,
+               const std::vector<const char*>& feedback_varyings)
     : shader_name_(shader_name) {
   std::cout << "Creating " << shader_name << "\n";
 
@@ -100,97 +110,132 @@ shader::shader(const char* shader_name, const char* vertex_shader_source_code,
   // Link shader
   glAttachShader(program_, vertex_shader);
   glAttachShader(program_, fragment_shader);
+  if (!feedback_varyings.empty())
+    glTransformFeedbackVaryings(program_, GLsizei(feedback_varyings.size()),
+                                feedback_varyings.data(), GL_SEPARATE_ATTRIBS);
   glLinkProgram(program_);
 
   glGetProgramiv(program_, GL_LINK_STATUS, &success);
   if (!success) {
     glGetProgramInfoLog(program_, sizeof info_log, nullptr, info_log);
     std::cout << info_log << "\n";
+  } else {
+    build_uniform_table();
   }
 
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
 }
 
+void shader::build_uniform_table() {
+  GLint count = 0, max_length = 0;
+  glGetProgramiv(program_, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<GLchar> name(size_t(std::max(max_length, 1)));
+  uniform_locations_.clear();
+  for (GLuint i = 0; i < GLuint(count); ++i) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program_, i, GLsizei(name.size()), &length, &size,
+                       &type, name.data());
+    std::string uniform_name(name.data(), size_t(length));
+    // Arrays are reported as their first element
+    const auto bracket = uniform_name.find('[');
+    if (bracket != std::string::npos) uniform_name.resize(bracket);
+    // Uniforms of uniform blocks have no location
+    const GLint location = glGetUniformLocation(program_, name.data());
+    if (location != -1)
+      uniform_locations_.emplace_back(std::move(uniform_name), location);
+  }
+  std::sort(uniform_locations_.begin(), uniform_locations_.end());
+}
+
+GLint shader::location_of(const char* name) const {
+  const auto entry = std::lower_bound(
+      uniform_locations_.begin(), uniform_locations_.end(), name,
+      [](const std::pair<std::string, GLint>& uniform, const char* key) {
+        return strcmp(uniform.first.c_str(), key) < 0;
+      });
+  if (entry != uniform_locations_.end() && entry->first == name)
+    return entry->second;
+#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
+  std::cerr << "Warn: uniform " << name << " cannot be set in shader "
+            << shader_name_ << "\n";
+#endif
+  return -1;
+}
+
 void shader::use() const {
   glUseProgram(program_);
-  set_uniform("highlight_color", gltf_insight::configuration::highlight_color);
+  const auto& highlight_color = gltf_insight::configuration::highlight_color;
+  if (highlight_color_set_ && highlight_color_ == highlight_color) return;
+  set_uniform("highlight_color", highlight_color);
+  highlight_color_ = highlight_color;
+  highlight_color_set_ = true;
 }
 
 const char* shader::get_name() const { return shader_name_.c_str(); }
 
+void shader::set_uniform(uniform_handle<float> handle,
+                         const float value) const {
+  if (handle.location != -1) glUniform1f(handle.location, value);
+}
+
+void shader::set_uniform(uniform_handle<int> handle, const int value) const {
+  if (handle.location != -1) glUniform1i(handle.location, value);
+}
+
+void shader::set_uniform(uniform_handle<glm::vec4> handle,
+                         const glm::vec4& v) const {
+  if (handle.location != -1) glUniform4f(handle.location, v.x, v.y, v.z, v.w);
+}
+
+void shader::set_uniform(uniform_handle<glm::vec3> handle,
+                         const glm::vec3& v) const {
+  if (handle.location != -1) glUniform3f(handle.location, v.x, v.y, v.z);
+}
+
+void shader::set_uniform(uniform_handle<glm::mat4> handle,
+                         const glm::mat4& m) const {
+  if (handle.location != -1)
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(m));
+}
+
+void shader::set_uniform(uniform_handle<glm::mat3> handle,
+                         const glm::mat3& m) const {
+  if (handle.location != -1)
+    glUniformMatrix3fv(handle.location, 1, GL_FALSE, glm::value_ptr(m));
+}
+
 void shader::set_uniform(const char* name, const float value) const {
   if (!name) return;
-
-  const auto location = glGetUniformLocation(program_, name);
-  if (location != -1) glUniform1f(location, value);
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+  set_uniform(get_uniform<float>(name), value);
 }
 
 void shader::set_uniform(const char* name, const int value) const {
   if (!name) return;
-
-  const auto location = glGetUniformLocation(program_, name);
-  if (location != -1) glUniform1i(location, value);
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+  set_uniform(get_uniform<int>(name), value);
 }
 
 void shader::set_uniform(const char* name, const glm::vec4& v) const {
   if (!name) return;
-
-  const auto location = glGetUniformLocation(program_, name);
-  if (location != -1) glUniform4f(location, v.x, v.y, v.z, v.w);
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+  set_uniform(get_uniform<glm::vec4>(name), v);
 }
 
 void shader::set_uniform(const char* name, const glm::vec3& v) const {
   if (!name) return;
-
-  const auto location = glGetUniformLocation(program_, name);
-  if (location != -1) glUniform3f(location, v.x, v.y, v.z);
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+  set_uniform(get_uniform<glm::vec3>(name), v);
 }
 
 void shader::set_uniform(const char* name, const glm::mat4& m) const {
   if (!name) return;
-  const auto location = glGetUniformLocation(program_, name);
-
-  if (location != -1)
-    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(m));
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+  set_uniform(get_uniform<glm::mat4>(name), m);
 }
 
 void shader::set_uniform(const char* name, const glm::mat3& m) const {
   if (!name) return;
-  const auto location = glGetUniformLocation(program_, name);
-
-  if (location != -1)
-    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(m));
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+  set_uniform(get_uniform<glm::mat3>(name), m);
 }
 
 void shader::set_uniform(const char* name,
@@ -198,15 +243,30 @@ void shader::set_uniform(const char* name,
   if (!name) return;
   if (matrices.empty()) return;
 
-  const auto location = glGetUniformLocation(program_, name);
+  const auto location = location_of(name);
   if (location != -1)
     glUniformMatrix4fv(location, GLsizei(matrices.size()), GL_FALSE,
                        glm::value_ptr(matrices[0]));
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
+}
+
+void shader::set_uniform(const char* name,
+                         const std::vector<float>& values) const {
+  if (!name) return;
+  if (values.empty()) return;
+
+  const auto location = location_of(name);
+  if (location != -1)
+    glUniform1fv(location, GLsizei(values.size()), values.data());
+}
+
+void shader::set_uniform(const char* name,
+                         const std::vector<int>& values) const {
+  if (!name) return;
+  if (values.empty()) return;
+
+  const auto location = location_of(name);
+  if (location != -1)
+    glUniform1iv(location, GLsizei(values.size()), values.data());
 }
 
 void shader::set_uniform(const char* name, size_t number_of_matrices,
@@ -215,14 +275,9 @@ void shader::set_uniform(const char* name, size_t number_of_matrices,
   if (!number_of_matrices) return;
   if (!data) return;
 
-  const auto location = glGetUniformLocation(program_, name);
+  const auto location = location_of(name);
   if (location != -1)
     glUniformMatrix4fv(location, GLsizei(number_of_matrices), GL_FALSE, data);
-#if defined(UNIFORM_DEBUG_VERBOSE) && (defined(DEBUG) || defined(_DEBUG))
-  else
-    std::cerr << "Warn: uniform " << name << " cannot be set in shader "
-              << shader_name_ << "\n";
-#endif
 }
 
 GLuint shader::get_program() const { return program_; }
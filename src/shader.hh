@@ -41,35 +41,75 @@ SOFTWARE.
 #endif
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "configuration.hh"
 
+/// Location of a uniform of type `T` in a shader, resolved once by
+/// `shader::get_uniform()` and kept by the caller. Setting a uniform the
+/// shader doesn't have does nothing, like setting it by name.
+template <typename T>
+struct uniform_handle {
+  GLint location = -1;
+};
+
 class shader {
-  GLuint program_;
+  GLuint program_ = 0;
   std::string shader_name_;
+  /// Location of each active uniform, sorted by name. Arrays are listed
+  /// without their [0] suffix.
+  std::vector<std::pair<std::string, GLint>> uniform_locations_;
+  /// Last value of `highlight_color` set in the program
+  mutable glm::vec4 highlight_color_;
+  mutable bool highlight_color_set_ = false;
+
+  /// Read the locations of the active uniforms of the linked program
+  void build_uniform_table();
+  /// Location of `name` in the table, or -1
+  GLint location_of(const char* name) const;
 
  public:
   // default ctor
   shader();
   // delegate ctor
   shader(const char* shader_name, const std::string& vertex_shader_source_code,
-         const std::string& fragment_shader_source_code)
+         const std::string& fragment_shader_source_code,
+         const std::vector<const char*>& feedback_varyings = {})
       : shader(shader_name, vertex_shader_source_code.c_str(),
-               fragment_shader_source_code.c_str()) {}
-  // actual ctor
+               fragment_shader_source_code.c_str(), feedback_varyings) {}
+  // actual ctor. The vertex shader outputs named in `feedback_varyings` are
+  // captured by transform feedback, each in its own buffer.
   shader(const char* shader_name, const char* vertex_shader_source_code,
-         const char* fragment_shader_source_code);
+         const char* fragment_shader_source_code,
+         const std::vector<const char*>& feedback_varyings = {});
   ~shader();
   shader(shader&& other);
   shader& operator=(shader&& other);
   shader& operator=(const shader&) = delete;
   shader(const shader&) = delete;
 
+  /// Bind the program. `highlight_color` is only set when it changed.
   void use() const;
   GLuint get_program() const;
   const char* get_name() const;
 
+  template <typename T>
+  uniform_handle<T> get_uniform(const char* name) const {
+    uniform_handle<T> handle;
+    handle.location = location_of(name);
+    return handle;
+  }
+
+  /// Set a uniform from its handle, the program has to be in use
+  void set_uniform(uniform_handle<float> handle, const float value) const;
+  void set_uniform(uniform_handle<int> handle, const int value) const;
+  void set_uniform(uniform_handle<glm::vec4> handle, const glm::vec4& v) const;
+  void set_uniform(uniform_handle<glm::vec3> handle, const glm::vec3& v) const;
+  void set_uniform(uniform_handle<glm::mat4> handle, const glm::mat4& m) const;
+  void set_uniform(uniform_handle<glm::mat3> handle, const glm::mat3& m) const;
+
+  /// Set a uniform by name, through the location table
   void set_uniform(const char* name, const float value) const;
   void set_uniform(const char* name, const int value) const;
   void set_uniform(const char* name, const glm::vec4& v) const;
@@ -78,6 +118,9 @@ class shader {
   void set_uniform(const char* name, const glm::mat3& m) const;
   void set_uniform(const char* name,
                    const std::vector<glm::mat4>& matrices) const;
+  /// Set a whole uniform array of floats or ints
+  void set_uniform(const char* name, const std::vector<float>& values) const;
+  void set_uniform(const char* name, const std::vector<int>& values) const;
   void set_uniform(const char* name, size_t number_of_matrices,
                    float* data) const;
 };
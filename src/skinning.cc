@@ -0,0 +1,942 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "skinning.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GLTF_INSIGHT_SKINNING_SSE
+#include <xmmintrin.h>
+#endif
+
+// Packed morph deltas are widened with SSE2, or F16C for the half floats when
+// the compiler targets it, or NEON
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLTF_INSIGHT_SKINNING_SSE2
+#include <emmintrin.h>
+#endif
+// MSVC defines no F16C macro, but every AVX2 CPU has F16C. GCC and Clang only
+// enable it with -mf16c, that -mavx2 does not imply.
+#if defined(GLTF_INSIGHT_SKINNING_SSE2) && \
+    (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+#define GLTF_INSIGHT_SKINNING_F16C
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define GLTF_INSIGHT_SKINNING_NEON
+#include <arm_neon.h>
+#endif
+
+void build_skinning_palette(const std::vector<affine>& joint_matrices,
+                            std::vector<skinning_joint>& palette) {
+  palette.resize(joint_matrices.size());
+  for (size_t i = 0; i < joint_matrices.size(); ++i) {
+    const auto& rows = joint_matrices[i].rows;
+    auto& joint = palette[i];
+    for (int column = 0; column < 4; ++column)
+      joint.columns[column] = glm::vec4(rows[0][column], rows[1][column],
+                                        rows[2][column], 0.f);
+  }
+}
+
+void build_dual_quaternion_palette(const std::vector<affine>& joint_matrices,
+                                   std::vector<dual_quaternion>& palette) {
+  palette.resize(joint_matrices.size());
+  for (size_t i = 0; i < joint_matrices.size(); ++i)
+    palette[i] = dual_quaternion_from_affine(joint_matrices[i]);
+}
+
+void build_skin_influences(const std::vector<unsigned short>& joints,
+                           const std::vector<float>& weights,
+                           skin_influences& influences) {
+  const size_t vertex_count = joints.size() / 4;
+  influences.vertex_count = vertex_count;
+  influences.influence_count = 0;
+  influences.max_influences = 0;
+  influences.buckets.clear();
+
+  // Index of the bucket of each influence count, in the bucket list
+  const size_t no_bucket = std::numeric_limits<size_t>::max();
+  std::vector<size_t> bucket_of_count;
+  std::vector<unsigned short> vertex_joints;
+  std::vector<float> vertex_weights;
+  for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+    vertex_joints.clear();
+    vertex_weights.clear();
+    for (size_t set = 0; set <= influences.extra_sets; ++set) {
+      const unsigned short* set_joints =
+          set == 0 ? &joints[4 * vertex]
+                   : &influences.extra_joints[4 * ((set - 1) * vertex_count +
+                                                   vertex)];
+      const float* set_weights =
+          set == 0 ? &weights[4 * vertex]
+                   : &influences.extra_weights[4 * ((set - 1) * vertex_count +
+                                                    vertex)];
+      for (size_t k = 0; k < 4; ++k) {
+        if (set_weights[k] == 0.f) continue;
+        vertex_joints.push_back(set_joints[k]);
+        vertex_weights.push_back(set_weights[k]);
+      }
+    }
+
+    const size_t count = vertex_joints.size();
+    if (count >= bucket_of_count.size())
+      bucket_of_count.resize(count + 1, no_bucket);
+    if (bucket_of_count[count] == no_bucket) {
+      bucket_of_count[count] = influences.buckets.size();
+      influences.buckets.emplace_back();
+      influences.buckets.back().count = count;
+    }
+
+    auto& bucket = influences.buckets[bucket_of_count[count]];
+    bucket.vertices.push_back(unsigned(vertex));
+    bucket.joints.insert(bucket.joints.end(), vertex_joints.begin(),
+                         vertex_joints.end());
+    bucket.weights.insert(bucket.weights.end(), vertex_weights.begin(),
+                          vertex_weights.end());
+    influences.influence_count += count;
+    influences.max_influences = std::max(influences.max_influences, count);
+  }
+
+  std::sort(influences.buckets.begin(), influences.buckets.end(),
+            [](const skin_influences::bucket& a,
+               const skin_influences::bucket& b) { return a.count < b.count; });
+}
+
+void encode_skin_influences(const skin_influences& influences,
+                            std::vector<float>& offsets,
+                            std::vector<float>& entries) {
+  // Count the influences of each vertex, then turn the counts into offsets
+  offsets.assign(influences.vertex_count + 1, 0.f);
+  for (const auto& bucket : influences.buckets)
+    for (const auto vertex : bucket.vertices)
+      offsets[vertex + 1] = float(bucket.count);
+  for (size_t vertex = 0; vertex < influences.vertex_count; ++vertex)
+    offsets[vertex + 1] += offsets[vertex];
+
+  entries.resize(2 * influences.influence_count);
+  for (const auto& bucket : influences.buckets) {
+    for (size_t i = 0; i < bucket.vertices.size(); ++i) {
+      const auto first = size_t(offsets[bucket.vertices[i]]);
+      for (size_t k = 0; k < bucket.count; ++k) {
+        entries[2 * (first + k)] = float(bucket.joints[bucket.count * i + k]);
+        entries[2 * (first + k) + 1] = bucket.weights[bucket.count * i + k];
+      }
+    }
+  }
+}
+
+namespace {
+/// The columns of the joints of a vertex, blended. Used for the vertices that
+/// are not skinned 4 at a time.
+struct blended_joint {
+  glm::vec4 columns[4];
+
+  blended_joint() {
+    for (auto& column : columns) column = glm::vec4(0.f);
+  }
+
+  void add(const skinning_joint& joint, float weight) {
+    for (int column = 0; column < 4; ++column)
+      columns[column] += weight * joint.columns[column];
+  }
+
+  void transform(const float* p, const float* n, float* skinned_position,
+                 float* skinned_normal) const {
+    const glm::vec4 position = columns[3] + p[0] * columns[0] +
+                               p[1] * columns[1] + p[2] * columns[2];
+
+    // The normal matrix, the inverse transpose of the linear part [a b c], is
+    // its cofactor matrix [b x c, c x a, a x b] over its determinant. Only the
+    // sign of the determinant matters once the normal is normalized.
+    const glm::vec3 a(columns[0]), b(columns[1]), c(columns[2]);
+    const glm::vec3 bc = glm::cross(b, c);
+    glm::vec3 normal =
+        n[0] * bc + n[1] * glm::cross(c, a) + n[2] * glm::cross(a, b);
+    float length = glm::length(normal);
+    if (glm::dot(a, bc) < 0.f) length = -length;
+    if (length != 0.f) normal /= length;
+
+    memcpy(skinned_position, &position.x, 3 * sizeof(float));
+    memcpy(skinned_normal, &normal.x, 3 * sizeof(float));
+  }
+};
+
+/// Sum of weighted dual quaternions
+struct blended_dual_quaternion {
+#ifdef GLTF_INSIGHT_SKINNING_SSE
+  __m128 real_sum = _mm_setzero_ps(), dual_sum = _mm_setzero_ps();
+#else
+  dual_quaternion sum = {};
+#endif
+  /// Rotation of the first joint. q and -q are the same rotation, the joints
+  /// are blended in the same hemisphere as this one.
+  glm::vec4 pivot = glm::vec4(0.f);
+
+  void add(const dual_quaternion& joint, float weight) {
+    if (glm::dot(pivot, joint.real) < 0.f) weight = -weight;
+    if (pivot == glm::vec4(0.f)) pivot = joint.real;
+#ifdef GLTF_INSIGHT_SKINNING_SSE
+    const __m128 w = _mm_set1_ps(weight);
+    real_sum =
+        _mm_add_ps(real_sum, _mm_mul_ps(w, _mm_loadu_ps(&joint.real.x)));
+    dual_sum =
+        _mm_add_ps(dual_sum, _mm_mul_ps(w, _mm_loadu_ps(&joint.dual.x)));
+#else
+    sum.real += weight * joint.real;
+    sum.dual += weight * joint.dual;
+#endif
+  }
+
+  dual_quaternion get() const {
+#ifdef GLTF_INSIGHT_SKINNING_SSE
+    dual_quaternion blended;
+    _mm_storeu_ps(&blended.real.x, real_sum);
+    _mm_storeu_ps(&blended.dual.x, dual_sum);
+    return blended;
+#else
+    return sum;
+#endif
+  }
+
+  void transform(const float* p, const float* n, float* skinned_position,
+                 float* skinned_normal) const {
+    const dual_quaternion blended = get();
+    const float length = glm::length(blended.real);
+    if (length == 0.f) {
+      memset(skinned_position, 0, 3 * sizeof(float));
+      memset(skinned_normal, 0, 3 * sizeof(float));
+      return;
+    }
+
+    // Rotate, then translate by 2 * dual * conjugate(real)
+    const glm::vec4 real = blended.real / length;
+    const glm::vec4 dual = blended.dual / length;
+    const glm::vec3 axis(real), dual_axis(dual);
+    const glm::vec3 position(p[0], p[1], p[2]), normal(n[0], n[1], n[2]);
+    const glm::vec3 skinned =
+        position +
+        2.f * glm::cross(axis, glm::cross(axis, position) + real.w * position) +
+        2.f * (real.w * dual_axis - dual.w * axis +
+               glm::cross(axis, dual_axis));
+    // Morphed normals are not unit length, normalize like the linear blend
+    glm::vec3 rotated_normal =
+        normal +
+        2.f * glm::cross(axis, glm::cross(axis, normal) + real.w * normal);
+    const float normal_length = glm::length(rotated_normal);
+    if (normal_length != 0.f) rotated_normal /= normal_length;
+
+    memcpy(skinned_position, &skinned.x, 3 * sizeof(float));
+    memcpy(skinned_normal, &rotated_normal.x, 3 * sizeof(float));
+  }
+};
+
+/// Position of the first vertex not below `vertex` in the list of a sparse
+/// target
+inline size_t first_sparse_delta(const morph_blend& morph, size_t target,
+                                 size_t vertex) {
+  const unsigned* indices = morph.indices[target];
+  return size_t(std::lower_bound(indices, indices + morph.sizes[target],
+                                 vertex) -
+                indices);
+}
+
+/// Decode the xyz delta at position `delta` of an array in `format`, without
+/// its scale
+inline void load_delta(morph_delta_format format, const void* deltas,
+                       size_t delta, float* xyz) {
+  switch (format) {
+    case morph_delta_format::float32:
+      memcpy(xyz, static_cast<const float*>(deltas) + 3 * delta,
+             3 * sizeof(float));
+      break;
+    case morph_delta_format::float16:
+      for (size_t i = 0; i < 3; ++i)
+        xyz[i] = half_to_float(
+            static_cast<const uint16_t*>(deltas)[3 * delta + i]);
+      break;
+    case morph_delta_format::int16:
+      for (size_t i = 0; i < 3; ++i)
+        xyz[i] = float(static_cast<const int16_t*>(deltas)[3 * delta + i]);
+      break;
+  }
+}
+
+/// Add the weighted deltas of the morph targets to a vertex. `morphed` gets
+/// the position, then the normal. `cursors` hold the position of each sparse
+/// target in its vertex list, the vertices have to come in increasing order.
+inline void morph_vertex(const morph_blend& morph, size_t vertex,
+                         const float* p, const float* n, size_t* cursors,
+                         float* morphed) {
+  for (size_t i = 0; i < 3; ++i) {
+    morphed[i] = p[i];
+    morphed[3 + i] = n[i];
+  }
+  for (size_t target = 0; target < morph.weights.size(); ++target) {
+    size_t delta = vertex;
+    if (const unsigned* indices = morph.indices[target]) {
+      size_t& cursor = cursors[target];
+      const size_t size = morph.sizes[target];
+      while (cursor < size && indices[cursor] < vertex) ++cursor;
+      if (cursor == size || indices[cursor] != vertex) continue;
+      delta = cursor;
+    }
+    const float weight = morph.weights[target];
+    const float position_weight = weight * morph.position_scales[target];
+    const float normal_weight = weight * morph.normal_scales[target];
+    float position_delta[3], normal_delta[3];
+    load_delta(morph.format, morph.position_deltas[target], delta,
+               position_delta);
+    load_delta(morph.format, morph.normal_deltas[target], delta, normal_delta);
+    for (size_t i = 0; i < 3; ++i) {
+      morphed[i] += position_weight * position_delta[i];
+      morphed[3 + i] += normal_weight * normal_delta[i];
+    }
+  }
+}
+
+/// Skin the vertices of [first; last) of a bucket that can be skinned several
+/// at a time, return the first one left. Only the linear blend skinning with
+/// SSE does.
+template <size_t Count, typename Joint>
+size_t skin_bucket_x4(const std::vector<Joint>&,
+                      const skin_influences::bucket&, size_t,
+                      const morph_blend*, size_t*, size_t first, size_t,
+                      const float*, const float*, float*, float*) {
+  return first;
+}
+
+#ifdef GLTF_INSIGHT_SKINNING_SSE
+/// x, y and z of the same column of 4 joints, one joint per lane
+inline void load_columns(const skinning_joint* const joints[4], int column,
+                         __m128* xyz) {
+  __m128 c0 = _mm_loadu_ps(&joints[0]->columns[column].x);
+  __m128 c1 = _mm_loadu_ps(&joints[1]->columns[column].x);
+  __m128 c2 = _mm_loadu_ps(&joints[2]->columns[column].x);
+  __m128 c3 = _mm_loadu_ps(&joints[3]->columns[column].x);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  xyz[0] = c0;
+  xyz[1] = c1;
+  xyz[2] = c2;
+}
+
+inline void cross(const __m128* u, const __m128* v, __m128* result) {
+  result[0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+  result[1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+  result[2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+}
+
+/// Linear blend skinning of 4 vertices at a time, one per lane. The joint
+/// columns and the vertices are transposed on load, so the blend and the
+/// transform work on the x, y and z of 4 vertices. Same computation as
+/// blended_joint.
+template <size_t Count>
+size_t skin_bucket_x4(const std::vector<skinning_joint>& palette,
+                      const skin_influences::bucket& bucket, size_t count,
+                      const morph_blend* morph, size_t* cursors, size_t first,
+                      size_t last, const float* positions,
+                      const float* normals, float* skinned_positions,
+                      float* skinned_normals) {
+  if (Count != 0) count = Count;
+  size_t i = first;
+  for (; i + 4 <= last; i += 4) {
+    __m128 blended[4][3];
+    for (auto& column : blended)
+      for (auto& xyz : column) xyz = _mm_setzero_ps();
+    for (size_t k = 0; k < count; ++k) {
+      const skinning_joint* joints[4];
+      float weights[4];
+      for (size_t lane = 0; lane < 4; ++lane) {
+        joints[lane] = &palette[bucket.joints[count * (i + lane) + k]];
+        weights[lane] = bucket.weights[count * (i + lane) + k];
+      }
+      const __m128 w = _mm_loadu_ps(weights);
+      for (int column = 0; column < 4; ++column) {
+        __m128 xyz[3];
+        load_columns(joints, column, xyz);
+        for (int j = 0; j < 3; ++j)
+          blended[column][j] =
+              _mm_add_ps(blended[column][j], _mm_mul_ps(w, xyz[j]));
+      }
+    }
+
+    const float* p[4];
+    const float* n[4];
+    float morphed[4][6];
+    for (size_t lane = 0; lane < 4; ++lane) {
+      const size_t vertex = bucket.vertices[i + lane];
+      p[lane] = positions + 3 * vertex;
+      n[lane] = normals + 3 * vertex;
+      if (morph) {
+        morph_vertex(*morph, vertex, p[lane], n[lane], cursors,
+                     morphed[lane]);
+        p[lane] = morphed[lane];
+        n[lane] = morphed[lane] + 3;
+      }
+    }
+
+    __m128 position[4], normal[4], cofactors[3][3];
+    const __m128 px = _mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0]);
+    const __m128 py = _mm_setr_ps(p[0][1], p[1][1], p[2][1], p[3][1]);
+    const __m128 pz = _mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2]);
+    for (int j = 0; j < 3; ++j)
+      position[j] = _mm_add_ps(
+          _mm_add_ps(_mm_add_ps(blended[3][j], _mm_mul_ps(px, blended[0][j])),
+                     _mm_mul_ps(py, blended[1][j])),
+          _mm_mul_ps(pz, blended[2][j]));
+    cross(blended[1], blended[2], cofactors[0]);
+    cross(blended[2], blended[0], cofactors[1]);
+    cross(blended[0], blended[1], cofactors[2]);
+    const __m128 nx = _mm_setr_ps(n[0][0], n[1][0], n[2][0], n[3][0]);
+    const __m128 ny = _mm_setr_ps(n[0][1], n[1][1], n[2][1], n[3][1]);
+    const __m128 nz = _mm_setr_ps(n[0][2], n[1][2], n[2][2], n[3][2]);
+    __m128 length = _mm_setzero_ps(), determinant = _mm_setzero_ps();
+    for (int j = 0; j < 3; ++j) {
+      normal[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cofactors[0][j]),
+                                        _mm_mul_ps(ny, cofactors[1][j])),
+                             _mm_mul_ps(nz, cofactors[2][j]));
+      length = _mm_add_ps(length, _mm_mul_ps(normal[j], normal[j]));
+      determinant = _mm_add_ps(determinant,
+                               _mm_mul_ps(blended[0][j], cofactors[0][j]));
+    }
+
+    // Divide by the length with the sign of the determinant, or by 1 for the
+    // zero normals
+    length = _mm_sqrt_ps(length);
+    const __m128 zero = _mm_cmpeq_ps(length, _mm_setzero_ps());
+    length = _mm_or_ps(_mm_andnot_ps(zero, length),
+                       _mm_and_ps(zero, _mm_set1_ps(1.f)));
+    const __m128 sign = _mm_and_ps(_mm_cmplt_ps(determinant, _mm_setzero_ps()),
+                                   _mm_set1_ps(-0.f));
+    length = _mm_xor_ps(length, sign);
+    for (int j = 0; j < 3; ++j) normal[j] = _mm_div_ps(normal[j], length);
+
+    position[3] = normal[3] = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(position[0], position[1], position[2], position[3]);
+    _MM_TRANSPOSE4_PS(normal[0], normal[1], normal[2], normal[3]);
+    for (size_t lane = 0; lane < 4; ++lane) {
+      const size_t vertex = bucket.vertices[i + lane];
+      float result[8];
+      _mm_storeu_ps(result, position[lane]);
+      _mm_storeu_ps(result + 4, normal[lane]);
+      memcpy(skinned_positions + 3 * vertex, result, 3 * sizeof(float));
+      memcpy(skinned_normals + 3 * vertex, result + 4, 3 * sizeof(float));
+    }
+  }
+  return i;
+}
+#endif
+
+/// Skin the vertices [first; last) of a bucket. `Count` is the number of
+/// influences of the bucket when known at compile time, or 0 to use the
+/// runtime `count`. If `morph` is set, the vertices are morphed first.
+template <typename Blended, size_t Count, typename Joint>
+void skin_bucket(const std::vector<Joint>& palette,
+                 const skin_influences::bucket& bucket, size_t count,
+                 const morph_blend* morph, size_t first, size_t last,
+                 const float* positions, const float* normals,
+                 float* skinned_positions, float* skinned_normals) {
+  if (Count != 0) count = Count;
+  std::vector<size_t> cursors;
+  if (morph && first < last) {
+    cursors.resize(morph->weights.size());
+    for (size_t target = 0; target < cursors.size(); ++target)
+      if (morph->indices[target])
+        cursors[target] =
+            first_sparse_delta(*morph, target, bucket.vertices[first]);
+  }
+  first = skin_bucket_x4<Count>(palette, bucket, count, morph, cursors.data(),
+                                first, last, positions, normals,
+                                skinned_positions, skinned_normals);
+  for (size_t i = first; i < last; ++i) {
+    const unsigned short* joints = bucket.joints.data() + count * i;
+    const float* weights = bucket.weights.data() + count * i;
+    Blended blended;
+    for (size_t k = 0; k < count; ++k)
+      blended.add(palette[joints[k]], weights[k]);
+
+    const size_t vertex = bucket.vertices[i];
+    const float* p = positions + 3 * vertex;
+    const float* n = normals + 3 * vertex;
+    float morphed[6];
+    if (morph) {
+      morph_vertex(*morph, vertex, p, n, cursors.data(), morphed);
+      p = morphed;
+      n = morphed + 3;
+    }
+    blended.transform(p, n, skinned_positions + 3 * vertex,
+                      skinned_normals + 3 * vertex);
+  }
+}
+
+/// Skin the vertices [begin; end) of each bucket, blending the joints with
+/// `Blended`
+template <typename Blended, typename Joint>
+void skin_buckets(const std::vector<Joint>& palette,
+                  const skin_influences& influences, const morph_blend* morph,
+                  size_t begin, size_t end, const float* positions,
+                  const float* normals, float* skinned_positions,
+                  float* skinned_normals) {
+  for (const auto& bucket : influences.buckets) {
+    const size_t first = size_t(
+        std::lower_bound(bucket.vertices.begin(), bucket.vertices.end(),
+                         begin) -
+        bucket.vertices.begin());
+    const size_t last = size_t(
+        std::lower_bound(bucket.vertices.begin() + std::ptrdiff_t(first),
+                         bucket.vertices.end(), end) -
+        bucket.vertices.begin());
+    if (first == last) continue;
+
+    // glTF assets use 4 influences per vertex, or multiples of 4 when they
+    // have several JOINTS_n sets. Pruning the zero weights gives the counts
+    // below 4.
+    const size_t count = bucket.count;
+#define GLTF_INSIGHT_SKIN_BUCKET(N)                                            \
+  skin_bucket<Blended, N>(palette, bucket, count, morph, first, last,          \
+                          positions, normals, skinned_positions,               \
+                          skinned_normals)
+    switch (count) {
+      case 1:
+        GLTF_INSIGHT_SKIN_BUCKET(1);
+        break;
+      case 2:
+        GLTF_INSIGHT_SKIN_BUCKET(2);
+        break;
+      case 3:
+        GLTF_INSIGHT_SKIN_BUCKET(3);
+        break;
+      case 4:
+        GLTF_INSIGHT_SKIN_BUCKET(4);
+        break;
+      case 8:
+        GLTF_INSIGHT_SKIN_BUCKET(8);
+        break;
+      default:
+        GLTF_INSIGHT_SKIN_BUCKET(0);
+        break;
+    }
+#undef GLTF_INSIGHT_SKIN_BUCKET
+  }
+}
+
+/// y += a * x over `count` floats
+inline void axpy(float a, const float* x, float* y, size_t count) {
+  size_t i = 0;
+#ifdef GLTF_INSIGHT_SKINNING_SSE
+  const __m128 a4 = _mm_set1_ps(a);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                    _mm_mul_ps(a4, _mm_loadu_ps(x + i))));
+#endif
+  for (; i < count; ++i) y[i] += a * x[i];
+}
+
+#ifdef GLTF_INSIGHT_SKINNING_SSE2
+/// Load 4 consecutive 16 bit values in the low half of a register
+inline __m128i load_4x16(const void* values) {
+  long long bits;
+  memcpy(&bits, values, sizeof(bits));
+  return _mm_set_epi64x(0, bits);
+}
+
+#ifndef GLTF_INSIGHT_SKINNING_F16C
+/// Widen the 4 half floats held in the low 16 bits of each lane. Shifted in
+/// place, the exponent and mantissa of a half make a float 2^112 times
+/// smaller, subnormals included.
+inline __m128 half_to_float4(__m128i halves) {
+  const __m128i magnitude = _mm_and_si128(halves, _mm_set1_epi32(0x7fff));
+  const __m128i sign = _mm_slli_epi32(_mm_xor_si128(halves, magnitude), 16);
+  __m128 value = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)),
+                            _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+  // Infinities and NaNs keep an all ones exponent
+  const __m128i inf_nan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7bff));
+  value = _mm_or_ps(value, _mm_castsi128_ps(_mm_and_si128(
+                               inf_nan, _mm_set1_epi32(0x7f800000))));
+  return _mm_or_ps(value, _mm_castsi128_ps(sign));
+}
+#endif
+#endif
+
+/// y += a * x over `count` half floats
+inline void axpy_half(float a, const uint16_t* x, float* y, size_t count) {
+  size_t i = 0;
+#if defined(GLTF_INSIGHT_SKINNING_SSE2)
+  const __m128 a4 = _mm_set1_ps(a);
+  for (; i + 4 <= count; i += 4) {
+#ifdef GLTF_INSIGHT_SKINNING_F16C
+    const __m128 x4 = _mm_cvtph_ps(load_4x16(x + i));
+#else
+    const __m128 x4 = half_to_float4(
+        _mm_unpacklo_epi16(load_4x16(x + i), _mm_setzero_si128()));
+#endif
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a4, x4)));
+  }
+#elif defined(GLTF_INSIGHT_SKINNING_NEON)
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t x4 = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(x + i)));
+    vst1q_f32(y + i, vmlaq_n_f32(vld1q_f32(y + i), x4, a));
+  }
+#endif
+  for (; i < count; ++i) y[i] += a * half_to_float(x[i]);
+}
+
+/// y += a * x over `count` int16 values
+inline void axpy_int16(float a, const int16_t* x, float* y, size_t count) {
+  size_t i = 0;
+#if defined(GLTF_INSIGHT_SKINNING_SSE2)
+  const __m128 a4 = _mm_set1_ps(a);
+  for (; i + 4 <= count; i += 4) {
+    // Sign extend each value from the high half of a 32 bit lane
+    const __m128i x16 = load_4x16(x + i);
+    const __m128 x4 =
+        _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x16, x16), 16));
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a4, x4)));
+  }
+#elif defined(GLTF_INSIGHT_SKINNING_NEON)
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t x4 = vcvtq_f32_s32(vmovl_s16(vld1_s16(x + i)));
+    vst1q_f32(y + i, vmlaq_n_f32(vld1q_f32(y + i), x4, a));
+  }
+#endif
+  for (; i < count; ++i) y[i] += a * float(x[i]);
+}
+
+/// y += a * x over the `count` deltas of `x` in `format` starting at `first`
+inline void axpy(morph_delta_format format, float a, const void* x,
+                 size_t first, float* y, size_t count) {
+  switch (format) {
+    case morph_delta_format::float32:
+      axpy(a, static_cast<const float*>(x) + first, y, count);
+      break;
+    case morph_delta_format::float16:
+      axpy_half(a, static_cast<const uint16_t*>(x) + first, y, count);
+      break;
+    case morph_delta_format::int16:
+      axpy_int16(a, static_cast<const int16_t*>(x) + first, y, count);
+      break;
+  }
+}
+}  // namespace
+
+uint16_t float_to_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const auto sign = uint16_t((bits >> 16) & 0x8000u);
+  bits &= 0x7fffffffu;
+
+  // NaNs stay NaNs, and what rounds above 65504 becomes infinite
+  if (bits > 0x7f800000u) return uint16_t(sign | 0x7e00u);
+  if (bits >= 0x477ff000u) return uint16_t(sign | 0x7c00u);
+
+  // Below 2^-14 the half is subnormal, a multiple of 2^-24. Rounding may give
+  // the smallest normal half, that has the next bit pattern.
+  if (bits < 0x38800000u) {
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(magnitude));
+    return uint16_t(sign | uint16_t(std::lrint(magnitude * 16777216.f)));
+  }
+
+  // Rebias the exponent and round the mantissa to 10 bits, to nearest even.
+  // A carry correctly bumps the exponent.
+  const uint32_t rounded = bits + 0xfffu + ((bits >> 13) & 1u);
+  return uint16_t(sign | ((rounded - 0x38000000u) >> 13));
+}
+
+float half_to_float(uint16_t half) {
+  const uint32_t sign = uint32_t(half & 0x8000u) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+  uint32_t bits;
+  if (exponent == 0x1fu) {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else {
+    // Zero or subnormal, mantissa * 2^-24
+    const float magnitude = float(mantissa) * 5.96046448e-8f;
+    return sign ? -magnitude : magnitude;
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+float morph_deltas::pack(const std::vector<float>& deltas,
+                         morph_delta_format new_format) {
+  format = new_format;
+  scale = 1.f;
+  floats.clear();
+  packed.clear();
+  if (format == morph_delta_format::float32) {
+    floats = deltas;
+    return 0.f;
+  }
+
+  if (format == morph_delta_format::int16) {
+    float largest = 0.f;
+    for (const float delta : deltas)
+      largest = std::max(largest, std::abs(delta));
+    if (largest > 0.f) scale = largest / 32767.f;
+  }
+
+  packed.resize(deltas.size());
+  float error = 0.f;
+  for (size_t i = 0; i < deltas.size(); ++i) {
+    if (format == morph_delta_format::float16) {
+      packed[i] = float_to_half(deltas[i]);
+    } else {
+      const long quantized =
+          std::max(-32767L, std::min(32767L, std::lrint(deltas[i] / scale)));
+      packed[i] = uint16_t(int16_t(quantized));
+    }
+    error = std::max(error, std::abs((*this)[i] - deltas[i]));
+  }
+  return error;
+}
+
+size_t morph_deltas::size() const {
+  return format == morph_delta_format::float32 ? floats.size() : packed.size();
+}
+
+size_t morph_deltas::bytes() const {
+  return floats.size() * sizeof(float) + packed.size() * sizeof(uint16_t);
+}
+
+const void* morph_deltas::data() const {
+  if (format == morph_delta_format::float32) return floats.data();
+  return packed.data();
+}
+
+float morph_deltas::operator[](size_t index) const {
+  switch (format) {
+    case morph_delta_format::float16:
+      return half_to_float(packed[index]);
+    case morph_delta_format::int16:
+      return scale * float(int16_t(packed[index]));
+    case morph_delta_format::float32:
+      break;
+  }
+  return floats[index];
+}
+
+void skin_vertices(const std::vector<skinning_joint>& palette,
+                   const skin_influences& influences, size_t begin,
+                   size_t end, const float* positions, const float* normals,
+                   float* skinned_positions, float* skinned_normals) {
+  skin_buckets<blended_joint>(palette, influences, nullptr, begin, end,
+                              positions, normals, skinned_positions,
+                              skinned_normals);
+}
+
+void skin_vertices_reference(const std::vector<affine>& joint_matrices,
+                             const skin_influences& influences, size_t begin,
+                             size_t end, const float* positions,
+                             const float* normals, float* skinned_positions,
+                             float* skinned_normals) {
+  for (const auto& bucket : influences.buckets) {
+    for (size_t i = 0; i < bucket.vertices.size(); ++i) {
+      const size_t vertex = bucket.vertices[i];
+      if (vertex < begin || vertex >= end) continue;
+
+      affine skin_matrix;
+      for (auto& row : skin_matrix.rows) row = glm::vec4(0.f);
+      for (size_t k = 0; k < bucket.count; ++k) {
+        const auto& joint =
+            joint_matrices[bucket.joints[bucket.count * i + k]];
+        const float weight = bucket.weights[bucket.count * i + k];
+        for (int row = 0; row < 3; ++row)
+          skin_matrix.rows[row] += weight * joint.rows[row];
+      }
+
+      const glm::vec4 position(positions[3 * vertex],
+                               positions[3 * vertex + 1],
+                               positions[3 * vertex + 2], 1.f);
+      const glm::vec3 normal(normals[3 * vertex], normals[3 * vertex + 1],
+                             normals[3 * vertex + 2]);
+
+      // The rows of the affine matrix are the columns of the transposed
+      // linear part, whose inverse is the normal matrix
+      const glm::mat3 transposed_linear(glm::vec3(skin_matrix.rows[0]),
+                                        glm::vec3(skin_matrix.rows[1]),
+                                        glm::vec3(skin_matrix.rows[2]));
+      const glm::vec3 skinned_position(glm::dot(skin_matrix.rows[0], position),
+                                       glm::dot(skin_matrix.rows[1], position),
+                                       glm::dot(skin_matrix.rows[2], position));
+      // Vertices without influences collapse, like in the kernel
+      glm::vec3 skinned_normal(0.f);
+      if (glm::determinant(transposed_linear) != 0.f)
+        skinned_normal = glm::inverse(transposed_linear) * normal;
+      const float length = glm::length(skinned_normal);
+      if (length > 0.f) skinned_normal /= length;
+
+      memcpy(skinned_positions + 3 * vertex, &skinned_position.x,
+             3 * sizeof(float));
+      memcpy(skinned_normals + 3 * vertex, &skinned_normal.x,
+             3 * sizeof(float));
+    }
+  }
+}
+
+bool skinning_error::within_tolerance() const {
+  return position <= 1e-5f && normal <= 1e-4f;
+}
+
+skinning_error check_skinned_vertices(const std::vector<affine>& joint_matrices,
+                                      const skin_influences& influences,
+                                      size_t begin, size_t end,
+                                      const float* positions,
+                                      const float* normals,
+                                      const float* skinned_positions,
+                                      const float* skinned_normals) {
+  skinning_error error;
+  end = std::min(end, influences.vertex_count);
+  if (begin >= end) return error;
+  std::vector<float> reference_positions(3 * influences.vertex_count),
+      reference_normals(3 * influences.vertex_count);
+  skin_vertices_reference(joint_matrices, influences, begin, end, positions,
+                          normals, reference_positions.data(),
+                          reference_normals.data());
+
+  error.vertex_count = end - begin;
+  for (size_t vertex = begin; vertex < end; ++vertex) {
+    const float* reference = &reference_positions[3 * vertex];
+    const float size =
+        std::max({1.f, std::abs(reference[0]), std::abs(reference[1]),
+                  std::abs(reference[2])});
+    for (size_t i = 3 * vertex; i < 3 * vertex + 3; ++i) {
+      error.position =
+          std::max(error.position,
+                   std::abs(skinned_positions[i] - reference_positions[i]) /
+                       size);
+      error.normal = std::max(
+          error.normal, std::abs(skinned_normals[i] - reference_normals[i]));
+    }
+  }
+  return error;
+}
+
+void skin_vertices(const std::vector<dual_quaternion>& palette,
+                   const skin_influences& influences, size_t begin,
+                   size_t end, const float* positions, const float* normals,
+                   float* skinned_positions, float* skinned_normals) {
+  skin_buckets<blended_dual_quaternion>(palette, influences, nullptr, begin,
+                                        end, positions, normals,
+                                        skinned_positions, skinned_normals);
+}
+
+void morph_and_skin_vertices(const std::vector<skinning_joint>& palette,
+                             const skin_influences& influences,
+                             const morph_blend& morph, size_t begin,
+                             size_t end, const float* positions,
+                             const float* normals, float* skinned_positions,
+                             float* skinned_normals) {
+  skin_buckets<blended_joint>(palette, influences, &morph, begin, end,
+                              positions, normals, skinned_positions,
+                              skinned_normals);
+}
+
+void morph_and_skin_vertices(const std::vector<dual_quaternion>& palette,
+                             const skin_influences& influences,
+                             const morph_blend& morph, size_t begin,
+                             size_t end, const float* positions,
+                             const float* normals, float* skinned_positions,
+                             float* skinned_normals) {
+  skin_buckets<blended_dual_quaternion>(palette, influences, &morph, begin,
+                                        end, positions, normals,
+                                        skinned_positions, skinned_normals);
+}
+
+void morph_blend::add(const morph_deltas& position, const morph_deltas& normal,
+                      const unsigned* sparse_indices, size_t size,
+                      float weight) {
+  if (weights.empty()) format = position.format;
+  assert(position.format == format && normal.format == format);
+  position_deltas.push_back(position.data());
+  normal_deltas.push_back(normal.data());
+  position_scales.push_back(position.scale);
+  normal_scales.push_back(normal.scale);
+  indices.push_back(sparse_indices);
+  sizes.push_back(size);
+  weights.push_back(weight);
+}
+
+size_t morph_blend::delta_bytes(size_t begin, size_t end) const {
+  const size_t value_size =
+      format == morph_delta_format::float32 ? sizeof(float) : sizeof(uint16_t);
+  size_t bytes = 0;
+  for (size_t target = 0; target < weights.size(); ++target)
+    if (indices[target])
+      bytes += (first_sparse_delta(*this, target, end) -
+                first_sparse_delta(*this, target, begin)) *
+               (6 * value_size + sizeof(unsigned));
+    else
+      bytes += (end - begin) * 6 * value_size;
+  return bytes;
+}
+
+void morph_vertices(const morph_blend& morph, size_t begin, size_t end,
+                    const float* positions, const float* normals,
+                    float* morphed_positions, float* morphed_normals) {
+  std::copy(positions + 3 * begin, positions + 3 * end,
+            morphed_positions + 3 * begin);
+  std::copy(normals + 3 * begin, normals + 3 * end,
+            morphed_normals + 3 * begin);
+
+  // One target after the other, so each delta array is read in order
+  for (size_t target = 0; target < morph.weights.size(); ++target) {
+    const float position_weight =
+        morph.weights[target] * morph.position_scales[target];
+    const float normal_weight =
+        morph.weights[target] * morph.normal_scales[target];
+    const void* position_deltas = morph.position_deltas[target];
+    const void* normal_deltas = morph.normal_deltas[target];
+    if (const unsigned* indices = morph.indices[target]) {
+      for (size_t delta = first_sparse_delta(morph, target, begin);
+           delta < morph.sizes[target] && indices[delta] < end; ++delta) {
+        const size_t vertex = indices[delta];
+        float position_delta[3], normal_delta[3];
+        load_delta(morph.format, position_deltas, delta, position_delta);
+        load_delta(morph.format, normal_deltas, delta, normal_delta);
+        for (size_t i = 0; i < 3; ++i) {
+          morphed_positions[3 * vertex + i] +=
+              position_weight * position_delta[i];
+          morphed_normals[3 * vertex + i] += normal_weight * normal_delta[i];
+        }
+      }
+    } else {
+      const size_t first = 3 * begin, count = 3 * (end - begin);
+      axpy(morph.format, position_weight, position_deltas, first,
+           morphed_positions + first, count);
+      axpy(morph.format, normal_weight, normal_deltas, first,
+           morphed_normals + first, count);
+    }
+  }
+}
@@ -0,0 +1,233 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+
+#include <glm/glm.hpp>
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#include "affine.hh"
+#include "dual_quaternion.hh"
+
+/// A joint matrix laid out for the CPU skinning kernel. The transform is
+/// stored by columns, so a vertex is skinned by scaling and adding whole
+/// columns.
+struct skinning_joint {
+  /// Columns of the linear part, then the translation. The w of each is 0
+  glm::vec4 columns[4];
+};
+
+/// How the joint transforms are blended
+enum class skinning_method {
+  /// Weighted sum of the joint matrices
+  linear_blend,
+  /// Normalized weighted sum of the joint dual quaternions. Keeps the volume
+  /// around twisted joints, but ignores the scale of the joints
+  dual_quaternion
+};
+
+/// Rebuild the skinning palette from the joint matrices
+void build_skinning_palette(const std::vector<affine>& joint_matrices,
+                            std::vector<skinning_joint>& palette);
+
+/// Rebuild the dual quaternion palette from the joint matrices
+void build_dual_quaternion_palette(const std::vector<affine>& joint_matrices,
+                                   std::vector<dual_quaternion>& palette);
+
+/// Joint influences of the vertices of a submesh, with the zero weights
+/// pruned. The vertices are grouped by number of influences, so each group can
+/// be skinned by a loop specialized for that count.
+struct skin_influences {
+  /// Vertices that have exactly `count` influences
+  struct bucket {
+    size_t count = 0;
+    /// Sorted vertex indices
+    std::vector<unsigned> vertices;
+    /// `count` entries per vertex
+    std::vector<unsigned short> joints;
+    std::vector<float> weights;
+  };
+
+  /// JOINTS_n and WEIGHTS_n for n >= 1, one set after the other, 4 values per
+  /// vertex. The first set is kept by the mesh, as vertex attributes.
+  size_t extra_sets = 0;
+  std::vector<unsigned short> extra_joints;
+  std::vector<float> extra_weights;
+
+  /// Sorted by influence count
+  std::vector<bucket> buckets;
+  size_t vertex_count = 0;
+  size_t influence_count = 0;
+  size_t max_influences = 0;
+};
+
+/// Rebuild the buckets from the first set of joints and weights, 4 per vertex,
+/// and the extra sets already stored in `influences`
+void build_skin_influences(const std::vector<unsigned short>& joints,
+                           const std::vector<float>& weights,
+                           skin_influences& influences);
+
+/// Lay out the influences by vertex, for the vertex shader. The influences of
+/// vertex `i` are the (joint, weight) pairs [offsets[i]; offsets[i + 1]) of
+/// `entries`.
+void encode_skin_influences(const skin_influences& influences,
+                            std::vector<float>& offsets,
+                            std::vector<float>& entries);
+
+/// Linear blend skinning of the vertices in [begin; end). Positions and
+/// normals are xyz triplets. The output normals are normalized. With SSE, the
+/// vertices of each bucket are skinned 4 at a time, one per lane.
+void skin_vertices(const std::vector<skinning_joint>& palette,
+                   const skin_influences& influences, size_t begin,
+                   size_t end, const float* positions, const float* normals,
+                   float* skinned_positions, float* skinned_normals);
+
+/// Plain linear blend skinning of the vertices in [begin; end), with a glm
+/// matrix blend and inverse per vertex, like the GPU skinning pass. Slow, used
+/// to check `skin_vertices()`.
+void skin_vertices_reference(const std::vector<affine>& joint_matrices,
+                             const skin_influences& influences, size_t begin,
+                             size_t end, const float* positions,
+                             const float* normals, float* skinned_positions,
+                             float* skinned_normals);
+
+/// Largest differences between vertices skinned by `skin_vertices()` and the
+/// reference. The position error is relative to the size of the position, or
+/// absolute below 1. The normal error is between the unit normals.
+struct skinning_error {
+  size_t vertex_count = 0;
+  float position = 0.f, normal = 0.f;
+
+  /// The errors are below 1e-5 for the positions and 1e-4 for the normals
+  bool within_tolerance() const;
+};
+
+/// Skin the vertices in [begin; end) with `skin_vertices_reference()`, and
+/// compare them to `skinned_positions` and `skinned_normals`
+skinning_error check_skinned_vertices(const std::vector<affine>& joint_matrices,
+                                      const skin_influences& influences,
+                                      size_t begin, size_t end,
+                                      const float* positions,
+                                      const float* normals,
+                                      const float* skinned_positions,
+                                      const float* skinned_normals);
+
+/// Dual quaternion skinning of the vertices in [begin; end), same layout as
+/// `skin_vertices()`
+void skin_vertices(const std::vector<dual_quaternion>& palette,
+                   const skin_influences& influences, size_t begin,
+                   size_t end, const float* positions, const float* normals,
+                   float* skinned_positions, float* skinned_normals);
+
+/// How the morph target deltas are stored
+enum class morph_delta_format {
+  /// 32 bit floats, as loaded
+  float32,
+  /// IEEE 754 half floats. The relative error is below 2^-11
+  float16,
+  /// Signed 16 bit integers, times a scale per array. The absolute error is
+  /// below half the scale
+  int16
+};
+
+/// Round a float to the nearest half float, as its bits
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t half);
+
+/// Morph target deltas, xyz triplets, as floats or packed in 16 bits
+struct morph_deltas {
+  morph_delta_format format = morph_delta_format::float32;
+  std::vector<float> floats;
+  /// The half floats, or the bits of the int16 values
+  std::vector<uint16_t> packed;
+  /// Factor of the int16 values, that maps the largest delta to 32767. 1 for
+  /// the other formats
+  float scale = 1.f;
+
+  /// Store `deltas` in `format`. Return the largest absolute error
+  float pack(const std::vector<float>& deltas, morph_delta_format format);
+  /// Number of values
+  size_t size() const;
+  size_t bytes() const;
+  const void* data() const;
+  /// Decode a value
+  float operator[](size_t index) const;
+};
+
+/// Morph targets to blend into a set of vertices. Only the targets with a non
+/// zero weight are listed.
+struct morph_blend {
+  /// Format of the deltas of all the targets
+  morph_delta_format format = morph_delta_format::float32;
+  /// Position and normal deltas of each target, xyz triplets in `format`
+  std::vector<const void*> position_deltas, normal_deltas;
+  /// Scale of the deltas of each target, see `morph_deltas`
+  std::vector<float> position_scales, normal_scales;
+  /// Sorted vertices moved by each sparse target, that has one delta per
+  /// vertex listed, and their count. nullptr for the dense targets, that have
+  /// one delta per vertex of the submesh.
+  std::vector<const unsigned*> indices;
+  std::vector<size_t> sizes;
+  std::vector<float> weights;
+
+  /// Add a target. `sparse_indices` is nullptr for a dense target. The
+  /// deltas have to be in the format of the targets already added.
+  void add(const morph_deltas& position, const morph_deltas& normal,
+           const unsigned* sparse_indices, size_t size, float weight);
+  /// Size of the deltas read to blend the vertices [begin; end)
+  size_t delta_bytes(size_t begin, size_t end) const;
+};
+
+/// Blend the morph targets into the vertices in [begin; end). Each target
+/// only goes through the vertices it moves. Packed deltas are decoded on the
+/// fly.
+void morph_vertices(const morph_blend& morph, size_t begin, size_t end,
+                    const float* positions, const float* normals,
+                    float* morphed_positions, float* morphed_normals);
+
+/// Morph then skin the vertices in [begin; end) in a single pass. The morphed
+/// vertices stay in registers, only the skinned ones are written.
+void morph_and_skin_vertices(const std::vector<skinning_joint>& palette,
+                             const skin_influences& influences,
+                             const morph_blend& morph, size_t begin,
+                             size_t end, const float* positions,
+                             const float* normals, float* skinned_positions,
+                             float* skinned_normals);
+void morph_and_skin_vertices(const std::vector<dual_quaternion>& palette,
+                             const skin_influences& influences,
+                             const morph_blend& morph, size_t begin,
+                             size_t end, const float* positions,
+                             const float* normals, float* skinned_positions,
+                             float* skinned_normals);
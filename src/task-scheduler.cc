@@ -0,0 +1,183 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "task-scheduler.hh"
+
+size_t task_graph::add(const std::string& name, std::function<void()> work) {
+  std::unique_ptr<task> t(new task);
+  t->name = name;
+  t->work = std::move(work);
+  tasks.push_back(std::move(t));
+  return tasks.size() - 1;
+}
+
+void task_graph::depend(size_t dependent, size_t dependency) {
+  tasks[dependency]->successors.push_back(dependent);
+  tasks[dependent]->dependencies++;
+}
+
+std::vector<task_timing> task_graph::timings() const {
+  std::vector<task_timing> output;
+  output.reserve(tasks.size());
+  for (const auto& t : tasks)
+    output.push_back(task_timing{t->name, t->thread, t->start, t->duration});
+  return output;
+}
+
+task_scheduler::task_scheduler(unsigned nb_threads) {
+#ifndef __EMSCRIPTEN__
+  if (nb_threads == 0) nb_threads = std::thread::hardware_concurrency();
+#endif
+  if (nb_threads == 0) nb_threads = 1;
+
+  for (unsigned i = 0; i < nb_threads; ++i)
+    queues.push_back(std::unique_ptr<queue>(new queue));
+
+#ifndef __EMSCRIPTEN__
+  for (unsigned i = 1; i < nb_threads; ++i)
+    workers.push_back(std::thread([this, i] { worker_loop(int(i)); }));
+#endif
+}
+
+task_scheduler::~task_scheduler() {
+  {
+    std::lock_guard<std::mutex> guard(state_lock);
+    stopping = true;
+  }
+  wake_up.notify_all();
+#ifndef __EMSCRIPTEN__
+  for (auto& worker : workers) worker.join();
+#endif
+}
+
+void task_scheduler::run(task_graph& graph) {
+  if (graph.tasks.empty()) return;
+
+  // Workers still spinning on the previous graph will pick up tasks as soon
+  // as `remaining` is set, the graph needs to be published first
+  current_graph = &graph;
+  graph_start = std::chrono::high_resolution_clock::now();
+  for (auto& t : graph.tasks) t->pending = t->dependencies;
+  remaining = graph.tasks.size();
+
+  // Spread the tasks that can start right away over all the queues
+  int next_queue = 0;
+  for (size_t i = 0; i < graph.tasks.size(); ++i) {
+    if (graph.tasks[i]->dependencies != 0) continue;
+    push(next_queue, i);
+    next_queue = (next_queue + 1) % int(queues.size());
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(state_lock);
+    generation++;
+  }
+  wake_up.notify_all();
+
+  work(0);
+}
+
+void task_scheduler::worker_loop(int thread) {
+  unsigned last_generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> guard(state_lock);
+      wake_up.wait(guard, [&] {
+        return stopping || generation != last_generation;
+      });
+      if (stopping) return;
+      last_generation = generation;
+    }
+    work(thread);
+  }
+}
+
+void task_scheduler::work(int thread) {
+  while (remaining > 0) {
+    size_t task;
+    if (pop(thread, task))
+      execute(thread, task);
+    else
+#ifndef __EMSCRIPTEN__
+      std::this_thread::yield();
+#else
+      break;
+#endif
+  }
+}
+
+bool task_scheduler::pop(int thread, size_t& task) {
+  // Newest task of our own queue, it is likely to touch data still in cache
+  {
+    auto& own = *queues[size_t(thread)];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      task = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // Steal the oldest task of another queue
+  for (size_t i = 1; i < queues.size(); ++i) {
+    auto& victim = *queues[(size_t(thread) + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void task_scheduler::push(int thread, size_t task) {
+  auto& own = *queues[size_t(thread)];
+  std::lock_guard<std::mutex> guard(own.lock);
+  own.tasks.push_back(task);
+}
+
+void task_scheduler::execute(int thread, size_t task) {
+  using milliseconds = std::chrono::duration<double, std::milli>;
+  using clock = std::chrono::high_resolution_clock;
+
+  auto& graph = *current_graph.load();
+  auto& t = *graph.tasks[task];
+
+  const auto start = clock::now();
+  t.work();
+  const auto end = clock::now();
+
+  t.thread = thread;
+  t.start = milliseconds(start - graph_start).count();
+  t.duration = milliseconds(end - start).count();
+
+  // Successors that have nothing left to wait for go in our own queue
+  for (const auto successor : t.successors)
+    if (--graph.tasks[successor]->pending == 0) push(thread, successor);
+
+  // This has to be the last access to the graph, as run() returns as soon as
+  // this reaches zero
+  remaining--;
+}
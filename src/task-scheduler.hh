@@ -0,0 +1,125 @@
+/*
+MIT License
+
+Copyright (c) 2019 Light Transport Entertainment Inc. And many contributors.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+/// Time spent in a task during the last run of its graph
+struct task_timing {
+  std::string name;
+  /// Index of the thread that executed it, 0 is the thread calling run()
+  int thread;
+  /// In milliseconds, relative to the start of the graph
+  double start, duration;
+};
+
+/// A set of tasks and the dependencies between them. Build it, then give it
+/// to `task_scheduler::run()`.
+class task_graph {
+ public:
+  /// Add a task, return its index
+  size_t add(const std::string& name, std::function<void()> work);
+
+  /// `dependent` will not start before `dependency` is done
+  void depend(size_t dependent, size_t dependency);
+
+  size_t size() const { return tasks.size(); }
+
+  /// Timing of each task of the last run
+  std::vector<task_timing> timings() const;
+
+ private:
+  friend class task_scheduler;
+
+  struct task {
+    std::string name;
+    std::function<void()> work;
+    std::vector<size_t> successors;
+    int dependencies = 0;
+    std::atomic<int> pending{0};
+    int thread = 0;
+    double start = 0, duration = 0;
+  };
+
+  std::vector<std::unique_ptr<task>> tasks;
+};
+
+/// Thread pool running task graphs. Each thread has its own queue, it runs
+/// the tasks it made ready last in first out, and steals the oldest tasks of
+/// the other queues when it runs out of work.
+class task_scheduler {
+ public:
+  /// Start `nb_threads - 1` workers, the thread calling run() is the last
+  /// one. By default, use all hardware threads.
+  explicit task_scheduler(unsigned nb_threads = 0);
+  ~task_scheduler();
+
+  /// Execute all the tasks of the graph, and return when they are all done
+  void run(task_graph& graph);
+
+  unsigned thread_count() const { return unsigned(queues.size()); }
+
+ private:
+  struct queue {
+    std::mutex lock;
+    std::deque<size_t> tasks;
+  };
+
+  std::vector<std::unique_ptr<queue>> queues;
+#ifndef __EMSCRIPTEN__
+  std::vector<std::thread> workers;
+#endif
+
+  /// Wakes the workers up when a graph starts, or when we are shutting down
+  std::mutex state_lock;
+  std::condition_variable wake_up;
+  unsigned generation = 0;
+  bool stopping = false;
+
+  std::atomic<task_graph*> current_graph{nullptr};
+
+  std::atomic<size_t> remaining{0};
+  std::chrono::high_resolution_clock::time_point graph_start;
+
+  void worker_loop(int thread);
+
+  /// Run tasks of the current graph until it is done
+  void work(int thread);
+
+  bool pop(int thread, size_t& task);
+  void push(int thread, size_t task);
+  void execute(int thread, size_t task);
+};